@@ -0,0 +1,1564 @@
+/*
+  tcanny_bench.cpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+// benchmark of each kernel, called directly on planes in memory.
+// the results are written as JSON, so that runs before and after a change
+// can be compared by a script.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#include "tcanny_core.hpp"
+#include "edgemask.hpp"
+#include "gaussian_blur.hpp"
+#include "utils.hpp"
+
+
+// the pitch is that of plan_pitch(), or an odd multiple of SCRATCH_ALIGN
+// if odd (--pitch). the base is shift bytes after the start of a page, so
+// planes of the same shift are 4K aliased.
+struct Plane {
+    uint8_t* base;
+    uint8_t* data;
+    int pitch;      // in bytes
+    Plane(int rowsize, int height, bool odd = false, int shift = 0) :
+        pitch(static_cast<int>(plan_pitch(rowsize, SCRATCH_ALIGN)))
+    {
+        if (odd && pitch / SCRATCH_ALIGN % 2 == 0) {
+            pitch += SCRATCH_ALIGN;
+        }
+        size_t size = static_cast<size_t>(pitch) * height;
+        base = reinterpret_cast<uint8_t*>(_mm_malloc(size + shift, 4096));
+        validate(!base, "failed to allocate a plane.");
+        data = base + shift;
+        memset(data, 0, size);
+    }
+    ~Plane() { _mm_free(base); }
+    Plane(const Plane&) = delete;
+    Plane& operator=(const Plane&) = delete;
+    template <typename T>
+    T* ptr() const { return reinterpret_cast<T*>(data); }
+};
+
+
+struct Options {
+    std::vector<arch_t> archs;
+    std::vector<std::string> stages;
+    std::vector<int> bits;
+    std::vector<int> radii;
+    std::vector<std::string> ops;
+    std::vector<std::string> sizes;
+    std::vector<std::string> images;
+    bool oddPitch;
+    double minTime;
+    std::string output;
+    bool verify;
+    int cases;
+    unsigned seed;
+};
+
+
+struct Result {
+    std::string stage;
+    std::string arch;
+    std::string image;
+    std::string op;
+    int bits;
+    int radius;
+    int width;
+    int height;
+    int iterations;
+    double ns;              // median time of a frame
+    double cycles;          // median TSC cycles of a frame
+    size_t bytes;           // bytes read and written in a frame
+};
+
+
+static const char* const all_stages[] = {
+    "cvt2flt", "gblur", "gblur_src", "emask", "emask_dir", "nms", "nms_hist",
+    "write_directions", "hysteresis",
+};
+
+static const struct { const char* name; int width; int height; } all_sizes[] = {
+    { "480p", 640, 480 },
+    { "720p", 1280, 720 },
+    { "1080p", 1920, 1080 },
+    { "4k", 3840, 2160 },
+    { "8k", 7680, 4320 },
+};
+
+
+static bool has(const std::vector<std::string>& v, const std::string& s)
+{
+    return std::find(v.begin(), v.end(), s) != v.end();
+}
+
+
+// runs f until both min_time and 3 iterations have passed, and returns the
+// medians of the time and of the TSC cycles.
+template <typename F>
+static void measure(F&& f, double min_time, Result& r)
+{
+    using namespace std::chrono;
+
+    f();    // warm up caches and page tables.
+
+    std::vector<double> ns, cycles;
+    double total = 0.0;
+    while ((ns.size() < 3 || total < min_time) && ns.size() < 1000) {
+        auto start = steady_clock::now();
+        auto c0 = __rdtsc();
+        f();
+        auto c1 = __rdtsc();
+        auto end = steady_clock::now();
+        double t = static_cast<double>(
+            duration_cast<nanoseconds>(end - start).count());
+        ns.push_back(t);
+        cycles.push_back(static_cast<double>(c1 - c0));
+        total += t * 1e-9;
+    }
+    auto median = [](std::vector<double>& v) {
+        std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+        return v[v.size() / 2];
+    };
+    r.iterations = static_cast<int>(ns.size());
+    r.ns = median(ns);
+    r.cycles = median(cycles);
+}
+
+
+// reads a binary PGM (P5) as values in [0, 1].
+static std::vector<float> read_pgm(const std::string& path, int& w, int& h)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    validate(!ifs, ("cannot open " + path).c_str());
+    std::string magic;
+    int maxv = 0;
+    ifs >> magic >> w >> h >> maxv;
+    ifs.get();
+    validate(magic != "P5" || w < 1 || h < 1 || maxv < 1 || maxv > 65535,
+        ("unsupported pgm " + path).c_str());
+
+    std::vector<float> img(static_cast<size_t>(w) * h);
+    int bps = maxv > 255 ? 2 : 1;
+    std::vector<uint8_t> row(static_cast<size_t>(w) * bps);
+    for (int y = 0; y < h; ++y) {
+        ifs.read(reinterpret_cast<char*>(row.data()), row.size());
+        validate(!ifs, ("truncated pgm " + path).c_str());
+        for (int x = 0; x < w; ++x) {
+            int v = bps == 1 ? row[x] : row[2 * x] << 8 | row[2 * x + 1];
+            img[static_cast<size_t>(y) * w + x] = static_cast<float>(v) / maxv;
+        }
+    }
+    return img;
+}
+
+
+// values in [0, 1].
+// noise: uniform white noise, the worst case for hysteresis.
+// ramp: diagonal gradient without edges.
+// shapes: random rectangles and discs on a flat background.
+// fbm: fractal value noise, which has the 1/f spectrum of natural images.
+// file:<path>: a PGM image, mirrored to fill the size.
+static std::vector<float>
+make_image(const std::string& name, int width, int height)
+{
+    std::vector<float> img(static_cast<size_t>(width) * height);
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> uni(0.0f, 1.0f);
+    auto at = [&](int x, int y) -> float& {
+        return img[static_cast<size_t>(y) * width + x];
+    };
+
+    if (name == "noise") {
+        for (auto& v : img) v = uni(rng);
+    } else if (name == "ramp") {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                at(x, y) = static_cast<float>(x + y) / (width + height);
+            }
+        }
+    } else if (name == "shapes") {
+        std::fill(img.begin(), img.end(), 0.25f);
+        int num = width * height / 4096;
+        for (int i = 0; i < num; ++i) {
+            int cx = static_cast<int>(uni(rng) * width);
+            int cy = static_cast<int>(uni(rng) * height);
+            int r = 4 + static_cast<int>(uni(rng) * 60);
+            float v = uni(rng);
+            bool disc = uni(rng) < 0.5f;
+            for (int y = std::max(cy - r, 0); y < std::min(cy + r, height); ++y) {
+                for (int x = std::max(cx - r, 0); x < std::min(cx + r, width); ++x) {
+                    if (!disc || (x - cx) * (x - cx) + (y - cy) * (y - cy) < r * r) {
+                        at(x, y) = v;
+                    }
+                }
+            }
+        }
+    } else if (name == "fbm") {
+        std::vector<float> lattice(257 * 257);
+        for (auto& v : lattice) v = uni(rng);
+        auto smooth = [](float t) { return t * t * (3.0f - 2.0f * t); };
+        auto value = [&](float fx, float fy) {
+            int ix = static_cast<int>(fx), iy = static_cast<int>(fy);
+            float tx = smooth(fx - ix), ty = smooth(fy - iy);
+            auto l = [&](int x, int y) { return lattice[(y & 255) * 257 + (x & 255)]; };
+            float a = l(ix, iy) + (l(ix + 1, iy) - l(ix, iy)) * tx;
+            float b = l(ix, iy + 1) + (l(ix + 1, iy + 1) - l(ix, iy + 1)) * tx;
+            return a + (b - a) * ty;
+        };
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                float sum = 0.0f, amp = 0.5f, f = 1.0f / 256;
+                for (int o = 0; o < 7; ++o) {
+                    sum += amp * value(x * f, y * f);
+                    amp *= 0.5f;
+                    f *= 2.0f;
+                }
+                at(x, y) = sum;
+            }
+        }
+    } else if (name.rfind("file:", 0) == 0) {
+        int w = 0, h = 0;
+        auto pgm = read_pgm(name.substr(5), w, h);
+        auto mirror = [](int i, int n) {
+            i %= 2 * n;
+            return i < n ? i : 2 * n - 1 - i;
+        };
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                at(x, y) = pgm[static_cast<size_t>(mirror(y, h)) * w
+                    + mirror(x, w)];
+            }
+        }
+    } else {
+        throw std::runtime_error(("unknown image " + name).c_str());
+    }
+    return img;
+}
+
+
+template <typename T>
+static void store_image(const std::vector<float>& img, int width, int height,
+    float maxval, Plane& p)
+{
+    for (int y = 0; y < height; ++y) {
+        T* d = reinterpret_cast<T*>(p.data + static_cast<size_t>(y) * p.pitch);
+        for (int x = 0; x < width; ++x) {
+            float v = img[static_cast<size_t>(y) * width + x] * maxval;
+            if constexpr (std::is_same_v<T, float>) {
+                d[x] = v;
+            } else {
+                d[x] = static_cast<T>(v + 0.5f);
+            }
+        }
+    }
+}
+
+
+static std::vector<float> make_weights(int radius)
+{
+    float sigma = radius / 3.0f;
+    std::vector<float> w(radius * 2 + 1);
+    float sum = 0.0f;
+    for (int r = -radius; r <= radius; ++r) {
+        w[r + radius] = std::exp((-1 * r * r) / (2.0f * sigma * sigma));
+        sum += w[r + radius];
+    }
+    for (auto& v : w) v /= sum;
+    return w;
+}
+
+
+static int operator_mode(const std::string& op, operator_t& opr)
+{
+    int mode = 0;
+    opr = parse_operator(op.c_str(), mode);
+    return mode;
+}
+
+
+// the buffer of the horizontal pass of gaussian blur, as TCannyCore has.
+struct HBuff {
+    Plane plane;
+    int pad;
+    HBuff(int width, int radius, bool odd = false, int shift = 0) :
+        plane(2 * pad_of(radius) + width * 4, 6, odd, shift),
+        pad(pad_of(radius)) {}
+    static int pad_of(int radius) { return (radius * 4 + 63) & ~63; }
+    float* ptr() const { return reinterpret_cast<float*>(plane.data + pad); }
+    int pitch() const { return plane.pitch / 4; }
+};
+
+
+static void bench_plane(const Options& opt, const std::string& image,
+    const std::vector<float>& img, int width, int height, int bits,
+    std::vector<Result>& results)
+{
+    const int bytes = (bits + 7) / 8;
+    const float maxval = bits == 32 ? 1.0f : 1.0f * (0xFF << (bits - 8));
+    const size_t pixels = static_cast<size_t>(width) * height;
+
+    // the bases are staggered by three cache lines, as the regions of the
+    // scratch buffer of TCannyCore are.
+    const bool odd = opt.oddPitch;
+    int planes = 0;
+    auto shift = [&] { return 3 * 64 * planes++; };
+
+    Plane src(width * bytes, height, odd, shift());
+    if (bytes == 1) store_image<uint8_t>(img, width, height, maxval, src);
+    if (bytes == 2) store_image<uint16_t>(img, width, height, maxval, src);
+    if (bytes == 4) store_image<float>(img, width, height, maxval, src);
+
+    // inputs of the later stages are made by the pipeline of TCannyMod
+    // (sigma = 1.0, standard operator, strict).
+    Plane blur(width * 4, height, odd, shift()),
+        emask(width * 4, height, odd, shift()),
+        dir(width * 4, height, odd, shift()),
+        nms(width * 4, height, odd, shift()),
+        out(width * 4, height, odd, shift());
+    const int hbShift = shift();
+    {
+        arch_t best = get_arch(-1);
+        operator_t opr;
+        int mode = operator_mode("standard", opr) | DETECT_EDGE
+            | CALC_DIRECTION | STRICT_MAGNITUDE;
+        auto w = make_weights(3);
+        HBuff hb(width, 3);
+        get_gblur(bytes, best, 3, mode)(src.data, src.pitch / bytes, hb.ptr(),
+            hb.pitch(), blur.data, blur.pitch / 4, width, height, 3, w.data(),
+            maxval);
+        get_emask(bytes, best, mode)(blur.ptr<float>(), blur.pitch / 4,
+            emask.data, emask.pitch / 4, opr, 1.0f, width, height, maxval,
+            dir.ptr<int32_t>(), dir.pitch / 4);
+        get_nms(best)(emask.ptr<float>(), emask.pitch / 4, dir.ptr<int32_t>(),
+            dir.pitch / 4, nms.ptr<float>(), nms.pitch / 4, width, height);
+    }
+
+    auto add = [&](const char* stage, const char* arch, const std::string& op,
+        int radius, size_t bytesPerPixel, auto&& f) {
+        if (!has(opt.stages, stage)) {
+            return;
+        }
+        Result r{};
+        r.stage = stage;
+        r.arch = arch;
+        r.image = image;
+        r.op = op;
+        r.bits = bits;
+        r.radius = radius;
+        r.width = width;
+        r.height = height;
+        r.bytes = bytesPerPixel * pixels;
+        measure(f, opt.minTime, r);
+        results.push_back(r);
+        fprintf(stderr, "%-16s %-7s %-8s %2d bits r%d %-8s %5dx%-5d %12.0f ns\n",
+            stage, arch, image.c_str(), bits, radius, op.c_str(), width,
+            height, r.ns);
+    };
+
+    for (auto arch : opt.archs) {
+        const char* a = a2s(arch);
+
+        add("cvt2flt", a, "", 0, bytes + 4, [&] {
+            get_gblur(bytes, arch, 1, DO_NOT_BLUR)(src.data, src.pitch / bytes,
+                nullptr, 0, out.data, out.pitch / 4, width, height, 0, nullptr,
+                maxval);
+        });
+
+        for (int radius : opt.radii) {
+            auto w = make_weights(radius);
+            HBuff hb(width, radius, odd, hbShift);
+            add("gblur", a, "", radius, bytes + 4, [&] {
+                get_gblur(bytes, arch, radius, DETECT_EDGE)(src.data,
+                    src.pitch / bytes, hb.ptr(), hb.pitch(), out.data,
+                    out.pitch / 4, width, height, radius, w.data(), maxval);
+            });
+            add("gblur_src", a, "", radius, bytes * 2, [&] {
+                get_gblur(bytes, arch, radius, DO_BLUR_ONLY)(src.data,
+                    src.pitch / bytes, hb.ptr(), hb.pitch(), out.data,
+                    out.pitch / bytes, width, height, radius, w.data(), maxval);
+            });
+        }
+
+        for (const auto& op : opt.ops) {
+            operator_t opr;
+            int mode = operator_mode(op, opr) | DETECT_EDGE;
+            add("emask", a, op, 0, 4 + bytes, [&] {
+                get_emask(bytes, arch, mode)(blur.ptr<float>(), blur.pitch / 4,
+                    out.data, out.pitch / bytes, opr, 1.0f, width, height,
+                    maxval, nullptr, 0);
+            });
+            mode |= CALC_DIRECTION | STRICT_MAGNITUDE;
+            add("emask_dir", a, op, 0, 4 + 4 + 4, [&] {
+                get_emask(bytes, arch, mode)(blur.ptr<float>(), blur.pitch / 4,
+                    out.data, out.pitch / 4, opr, 1.0f, width, height,
+                    maxval, dir.ptr<int32_t>(), dir.pitch / 4);
+            });
+        }
+
+        add("nms", a, "", 0, 4 + 4 + 4, [&] {
+            get_nms(arch)(emask.ptr<float>(), emask.pitch / 4,
+                dir.ptr<int32_t>(), dir.pitch / 4, out.ptr<float>(),
+                out.pitch / 4, width, height);
+        });
+
+        std::vector<uint32_t> hist(NMS_HIST_BINS * NMS_HIST_LANES);
+        float binscale = NMS_HIST_BINS / (2.0f * maxval);
+        add("nms_hist", a, "", 0, 4 + 4 + 4, [&] {
+            std::fill(hist.begin(), hist.end(), 0);
+            get_nms_hist(arch)(emask.ptr<float>(), emask.pitch / 4,
+                dir.ptr<int32_t>(), dir.pitch / 4, out.ptr<float>(),
+                out.pitch / 4, width, height, binscale, hist.data());
+        });
+    }
+
+    // they have no simd routine.
+    add("write_directions", "NO_SIMD", "", 0, 4 + bytes, [&] {
+        get_write_dir(bytes)(dir.ptr<int32_t>(), dir.pitch / 4, out.data,
+            out.pitch / bytes, width, height);
+    });
+
+    // thresholds of TCannyMod (1.0 and 8.0 for 8bit) scaled to the depth.
+    float tl = 1.0f * maxval / 255, th = 8.0f * maxval / 255;
+    add("hysteresis", "NO_SIMD", "", 0, 4 + bytes, [&] {
+        get_hysteresis(bytes)(out.data, out.pitch / bytes, nms.ptr<float>(),
+            nms.pitch / 4, width, height, tl, th, maxval, nullptr);
+    });
+}
+
+
+// --verify: each kernel of every arch is compared with the C kernel on
+// random sizes, pitches and bit depths.
+// float results may differ by a few ulp because of fma and of the order of
+// additions, and integer results by one lsb because such floats are
+// rounded. nms and hysteresis only compare values, so they must be exact.
+
+// a float result passes if it is within either ulp or abs.
+// abs is for results that are differences of larger values, whose ulp can
+// be far smaller than the rounding errors of those values.
+struct Tolerance {
+    int64_t ulp;        // float results
+    float abs;
+    int64_t lsb;        // integer results
+};
+
+static const Tolerance EXACT = { 0, 0.0f, 0 };
+
+
+static int64_t ulp_distance(float a, float b)
+{
+    int32_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    if (ia < 0) ia = INT32_MIN - ia;
+    if (ib < 0) ib = INT32_MIN - ib;
+    return std::abs(static_cast<int64_t>(ia) - ib);
+}
+
+
+struct Verifier {
+    std::mt19937 rng;
+    int checks;
+    int failures;
+
+    explicit Verifier(unsigned seed) : rng(seed), checks(0), failures(0) {}
+
+    int random(int lo, int hi)
+    {
+        return std::uniform_int_distribution<int>(lo, hi)(rng);
+    }
+
+    // a plane of height + 1 rows, padded by up to three cache lines.
+    // everything is filled with a pattern, so that pixels left unwritten by
+    // a kernel and writes to the guard row can be found.
+    std::unique_ptr<Plane> plane(int rowsize, int height, bool pad)
+    {
+        int extra = pad ? random(0, 3) * 64 : 0;
+        auto p = std::make_unique<Plane>(rowsize + extra, height + 1);
+        memset(p->data, 0xA5, static_cast<size_t>(p->pitch) * (height + 1));
+        return p;
+    }
+
+    // accept(x, y, value) can pass a pixel beyond the tolerance.
+    template <typename T>
+    void compare(const std::string& what, const Plane& ref, const Plane& out,
+        int width, int height, const Tolerance& tol,
+        const std::function<bool(int, int, T)>& accept = nullptr)
+    {
+        ++checks;
+        int64_t worst = 0, count = 0;
+        int wx = 0, wy = 0;
+        for (int y = 0; y < height; ++y) {
+            auto r = reinterpret_cast<const T*>(ref.data + static_cast<size_t>(y) * ref.pitch);
+            auto o = reinterpret_cast<const T*>(out.data + static_cast<size_t>(y) * out.pitch);
+            for (int x = 0; x < width; ++x) {
+                int64_t diff, limit;
+                if constexpr (std::is_same_v<T, float>) {
+                    diff = ulp_distance(r[x], o[x]);
+                    limit = std::abs(r[x] - o[x]) <= tol.abs ? diff : tol.ulp;
+                } else {
+                    diff = std::abs(static_cast<int64_t>(r[x]) - o[x]);
+                    limit = tol.lsb;
+                }
+                if (diff > limit && !(accept && accept(x, y, o[x]))) {
+                    if (count++ == 0 || diff > worst) {
+                        worst = diff;
+                        wx = x;
+                        wy = y;
+                    }
+                }
+            }
+        }
+
+        // the row under the plane must not be written.
+        const uint8_t* g = out.data + static_cast<size_t>(out.pitch) * height;
+        bool guard = std::all_of(g, g + out.pitch,
+            [](uint8_t v) { return v == 0xA5; });
+
+        if (count > 0 || !guard) {
+            ++failures;
+            fprintf(stderr, "FAIL %s %dx%d: ", what.c_str(), width, height);
+            if (count > 0) {
+                fprintf(stderr, "%lld pixels differ, worst %lld %s at %d,%d",
+                    static_cast<long long>(count), static_cast<long long>(worst),
+                    std::is_same_v<T, float> ? "ulp" : "lsb", wx, wy);
+            }
+            if (!guard) {
+                fprintf(stderr, "%swrites beyond the plane",
+                    count > 0 ? ", " : "");
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+
+    void compare(const std::string& what, const std::vector<uint32_t>& ref,
+        const std::vector<uint32_t>& out)
+    {
+        ++checks;
+        // lanes may be assigned in any way, so only their sums are compared.
+        for (int bin = 0; bin < NMS_HIST_BINS; ++bin) {
+            uint32_t r = 0, o = 0;
+            for (int lane = 0; lane < NMS_HIST_LANES; ++lane) {
+                r += ref[lane * NMS_HIST_BINS + bin];
+                o += out[lane * NMS_HIST_BINS + bin];
+            }
+            if (r != o) {
+                ++failures;
+                fprintf(stderr, "FAIL %s: bin %d has %u, expected %u\n",
+                    what.c_str(), bin, o, r);
+                return;
+            }
+        }
+    }
+};
+
+
+// a direction passes if it is the one of a gradient within e of the exact
+// gradient, as gx and gy have rounding errors of the order of e.
+static bool is_near_direction(const Plane& blur, const operator_t& opr, int x,
+    int y, int32_t dir, double e)
+{
+    auto at = [&](int dx, int dy) -> double {
+        return reinterpret_cast<const float*>(blur.data
+            + static_cast<size_t>(y + dy) * blur.pitch)[x + dx];
+    };
+    if (x < 1 || y < 1) {
+        return false;
+    }
+    double gx = opr[0] * (at(1, -1) - at(-1, -1)) + opr[1] * (at(1, 0) - at(-1, 0))
+        + opr[2] * (at(1, 1) - at(-1, 1));
+    double gy = opr[0] * (at(-1, -1) - at(-1, 1)) + opr[1] * (at(0, -1) - at(0, 1))
+        + opr[2] * (at(1, -1) - at(1, 1));
+
+    auto sector = [](double gx, double gy) {
+        if (gx == 0.0) return 63;
+        double t = gy / gx;
+        if (-0.41421356 <= t && t < 0.41421356) return 15;
+        if (0.41421356 <= t && t < 2.41421356) return 31;
+        if (2.41421356 <= t || t < -2.41421356) return 63;
+        return 127;
+    };
+    for (double ex : { -e, 0.0, e }) {
+        for (double ey : { -e, 0.0, e }) {
+            if (sector(gx + ex, gy + ey) == dir) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+// the same for the joint gradient of three planes. the eigenvector is taken
+// at the angle of the exact tensor, within its error from the rounding of e.
+static bool is_near_color_direction(const Plane* const* blur,
+    const operator_t& opr, int x, int y, int32_t dir, double e)
+{
+    if (x < 1 || y < 1) {
+        return false;
+    }
+    double gxx = 0.0, gyy = 0.0, gxy = 0.0;
+    for (int p = 0; p < 3; ++p) {
+        auto at = [&](int dx, int dy) -> double {
+            return reinterpret_cast<const float*>(blur[p]->data
+                + static_cast<size_t>(y + dy) * blur[p]->pitch)[x + dx];
+        };
+        double gx = opr[0] * (at(1, -1) - at(-1, -1))
+            + opr[1] * (at(1, 0) - at(-1, 0)) + opr[2] * (at(1, 1) - at(-1, 1));
+        double gy = opr[0] * (at(-1, -1) - at(-1, 1))
+            + opr[1] * (at(0, -1) - at(0, 1)) + opr[2] * (at(1, -1) - at(1, 1));
+        gxx += gx * gx;
+        gyy += gy * gy;
+        gxy += gx * gy;
+    }
+    double t = gxx - gyy, d = std::hypot(t, 2.0 * gxy);
+    double err = 8.0 * e * std::sqrt(gxx + gyy) + e * e;
+    // any direction passes where the tensor is isotropic within the error.
+    if (d <= err) {
+        return true;
+    }
+    double theta = 0.5 * std::atan2(2.0 * gxy, t);
+    double delta = std::min(err / d, 1.0);
+    for (double a : { theta - delta, theta, theta + delta }) {
+        double vx = std::cos(a), vy = std::sin(a);
+        double tan = vy / vx;
+        int sector = std::abs(vx) < 1e-12 ? 63
+            : (-0.41421356 <= tan && tan < 0.41421356) ? 15
+            : (0.41421356 <= tan && tan < 2.41421356) ? 31
+            : (2.41421356 <= tan || tan < -2.41421356) ? 63 : 127;
+        if (sector == dir) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// a pass of mt_expand or mt_inflate of masktools2, for morphology. pixels
+// beyond the plane are the nearest pixels of the plane.
+template <typename T>
+static void morph_pass(const Plane& src, Plane& dst, int width, int height,
+    bool expand)
+{
+    auto at = [&](int x, int y) {
+        x = std::clamp(x, 0, width - 1);
+        y = std::clamp(y, 0, height - 1);
+        return reinterpret_cast<const T*>(src.data
+            + static_cast<size_t>(y) * src.pitch)[x];
+    };
+    for (int y = 0; y < height; ++y) {
+        auto d = reinterpret_cast<T*>(dst.data
+            + static_cast<size_t>(y) * dst.pitch);
+        for (int x = 0; x < width; ++x) {
+            if (expand) {
+                T m = at(x, y);
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        m = std::max(m, at(x + dx, y + dy));
+                    }
+                }
+                d[x] = m;
+                continue;
+            }
+            auto sum = at(x - 1, y - 1) + at(x, y - 1) + at(x + 1, y - 1)
+                + at(x - 1, y) + at(x + 1, y) + at(x - 1, y + 1)
+                + at(x, y + 1) + at(x + 1, y + 1);
+            if constexpr (std::is_same_v<T, float>) {
+                d[x] = std::max(at(x, y), sum / 8.0f);
+            } else {
+                d[x] = std::max(at(x, y), static_cast<T>((sum + 4) >> 3));
+            }
+        }
+    }
+}
+
+
+// distance map by searching the square of radius around each pixel.
+template <typename T>
+static void distance_ref(const Plane& src, Plane& dst, int width, int height,
+    int radius, float maxval)
+{
+    const float k = maxval / radius;
+    const float ro = std::is_same_v<T, float> ? 0.0f : 0.5f;
+    for (int y = 0; y < height; ++y) {
+        auto d = reinterpret_cast<T*>(dst.data
+            + static_cast<size_t>(y) * dst.pitch);
+        for (int x = 0; x < width; ++x) {
+            int64_t d2 = static_cast<int64_t>(radius) * radius;
+            for (int v = std::max(y - radius, 0);
+                    v <= std::min(y + radius, height - 1); ++v) {
+                auto s = reinterpret_cast<const T*>(src.data
+                    + static_cast<size_t>(v) * src.pitch);
+                for (int u = std::max(x - radius, 0);
+                        u <= std::min(x + radius, width - 1); ++u) {
+                    if (s[u] != 0) {
+                        d2 = std::min<int64_t>(d2,
+                            (u - x) * (u - x) + (v - y) * (v - y));
+                    }
+                }
+            }
+            d[x] = d2 >= static_cast<int64_t>(radius) * radius
+                ? static_cast<T>(maxval)
+                : static_cast<T>(std::sqrt(static_cast<float>(d2)) * k + ro);
+        }
+    }
+}
+
+
+static void copy_plane(const Plane& src, Plane& dst, int rowsize, int height)
+{
+    for (int y = 0; y < height; ++y) {
+        memcpy(dst.data + static_cast<size_t>(y) * dst.pitch,
+            src.data + static_cast<size_t>(y) * src.pitch, rowsize);
+    }
+}
+
+
+template <typename T>
+static void compare_as(Verifier& v, int bytes, const std::string& what,
+    const Plane& ref, const Plane& out, int width, int height,
+    const Tolerance& tol)
+{
+    if (bytes == 1) v.compare<uint8_t>(what, ref, out, width, height, tol);
+    if (bytes == 2) v.compare<uint16_t>(what, ref, out, width, height, tol);
+    if (bytes == 4) v.compare<T>(what, ref, out, width, height, tol);
+}
+
+
+static void verify_plane(Verifier& v, const Options& opt,
+    const std::vector<float>& img, int width, int height, int bits)
+{
+    using P = std::unique_ptr<Plane>;
+    const int bytes = (bits + 7) / 8;
+    const float maxval = bits == 32 ? 1.0f : 1.0f * (0xFF << (bits - 8));
+    char buf[64];
+    snprintf(buf, sizeof(buf), " %d bits", bits);
+    const std::string depth = buf;
+
+    auto source = [&](bool pad) {
+        P p = v.plane(width * bytes, height, pad);
+        if (bytes == 1) store_image<uint8_t>(img, width, height, maxval, *p);
+        if (bytes == 2) store_image<uint16_t>(img, width, height, maxval, *p);
+        if (bytes == 4) store_image<float>(img, width, height, maxval, *p);
+        return p;
+    };
+    P srcRef = source(false);
+
+    // inputs of the later stages are made by the C kernels.
+    P blur = v.plane(width * 4, height, false);
+    P emask = v.plane(width * 4, height, false);
+    P dir = v.plane(width * 4, height, false);
+    P nms = v.plane(width * 4, height, false);
+    {
+        auto w = make_weights(1);
+        HBuff hb(width, 1);
+        operator_t opr;
+        int mode = operator_mode("standard", opr) | DETECT_EDGE
+            | CALC_DIRECTION | STRICT_MAGNITUDE;
+        get_gblur(bytes, NO_SIMD, 1, mode)(srcRef->data, srcRef->pitch / bytes,
+            hb.ptr(), hb.pitch(), blur->data, blur->pitch / 4, width, height,
+            1, w.data(), maxval);
+        get_emask(bytes, NO_SIMD, mode)(blur->ptr<float>(), blur->pitch / 4,
+            emask->data, emask->pitch / 4, opr, 1.0f, width, height, maxval,
+            dir->ptr<int32_t>(), dir->pitch / 4);
+        get_nms(NO_SIMD)(emask->ptr<float>(), emask->pitch / 4,
+            dir->ptr<int32_t>(), dir->pitch / 4, nms->ptr<float>(),
+            nms->pitch / 4, width, height);
+    }
+
+    for (auto arch : opt.archs) {
+        if (arch == NO_SIMD) {
+            continue;
+        }
+        const std::string a = std::string(" ") + a2s(arch);
+        P src = source(true);
+
+        {
+            P ref = v.plane(width * 4, height, false);
+            P out = v.plane(width * 4, height, true);
+            get_gblur(bytes, NO_SIMD, 1, DO_NOT_BLUR)(srcRef->data,
+                srcRef->pitch / bytes, nullptr, 0, ref->data, ref->pitch / 4,
+                width, height, 0, nullptr, maxval);
+            get_gblur(bytes, arch, 1, DO_NOT_BLUR)(src->data, src->pitch / bytes,
+                nullptr, 0, out->data, out->pitch / 4, width, height, 0,
+                nullptr, maxval);
+            v.compare<float>("cvt2flt" + a + depth, *ref, *out, width, height,
+                EXACT);
+        }
+
+        for (int radius = 1; radius <= GBLUR_MAX_RADIUS; ++radius) {
+            auto w = make_weights(radius);
+            HBuff hbRef(width, radius), hb(width, radius);
+            const std::string r = " r" + std::to_string(radius);
+
+            P ref = v.plane(width * 4, height, false);
+            P out = v.plane(width * 4, height, true);
+            get_gblur(bytes, NO_SIMD, radius, DETECT_EDGE)(srcRef->data,
+                srcRef->pitch / bytes, hbRef.ptr(), hbRef.pitch(), ref->data,
+                ref->pitch / 4, width, height, radius, w.data(), maxval);
+            get_gblur(bytes, arch, radius, DETECT_EDGE)(src->data,
+                src->pitch / bytes, hb.ptr(), hb.pitch(), out->data,
+                out->pitch / 4, width, height, radius, w.data(), maxval);
+            v.compare<float>("gblur" + a + depth + r, *ref, *out, width, height,
+                { 16, 0.0f, 0 });
+
+            for (int nt = 0; nt < 2; ++nt) {
+                int mode = DO_BLUR_ONLY | (nt ? STREAM_OUTPUT : 0);
+                if (nt && get_gblur(bytes, arch, radius, mode)
+                    == get_gblur(bytes, arch, radius, DO_BLUR_ONLY)) {
+                    continue;
+                }
+                P ref = v.plane(width * bytes, height, false);
+                P out = v.plane(width * bytes, height, true);
+                get_gblur(bytes, NO_SIMD, radius, mode)(srcRef->data,
+                    srcRef->pitch / bytes, hbRef.ptr(), hbRef.pitch(),
+                    ref->data, ref->pitch / bytes, width, height, radius,
+                    w.data(), maxval);
+                get_gblur(bytes, arch, radius, mode)(src->data,
+                    src->pitch / bytes, hb.ptr(), hb.pitch(), out->data,
+                    out->pitch / bytes, width, height, radius, w.data(),
+                    maxval);
+                compare_as<float>(v, bytes, (nt ? "gblur_src_nt" : "gblur_src")
+                    + a + depth + r, *ref, *out, width, height, { 16, 0.0f, 1 });
+            }
+        }
+
+        P bl = v.plane(width * 4, height, true);
+        copy_plane(*blur, *bl, width * 4, height);
+        for (const char* op : { "standard", "sobel", "1 3 2" }) {
+            for (int flags = 0; flags < 16; ++flags) {
+                const bool calcDir = flags & 1, strict = flags & 2,
+                    scale = flags & 4, nt = flags & 8;
+                operator_t opr;
+                int mode = operator_mode(op, opr) | DETECT_EDGE
+                    | (calcDir ? CALC_DIRECTION : 0)
+                    | (strict ? STRICT_MAGNITUDE : 0)
+                    | (scale ? SCALE_MAGNITUDE : 0);
+                if (nt && get_emask(bytes, arch, mode | STREAM_OUTPUT)
+                    == get_emask(bytes, arch, mode)) {
+                    continue;
+                }
+                if (nt) {
+                    mode |= STREAM_OUTPUT;
+                }
+                const float s = scale ? 1.7f : 1.0f;
+                const int ob = calcDir ? 4 : bytes;
+                std::string what = std::string(calcDir ? "emask_dir" : "emask")
+                    + (nt ? "_nt" : "") + a + depth + " " + op
+                    + (strict ? " strict" : "") + (scale ? " scale" : "");
+
+                P ref = v.plane(width * ob, height, false);
+                P out = v.plane(width * ob, height, true);
+                P dref = v.plane(width * 4, height, false);
+                P dout = v.plane(width * 4, height, true);
+                get_emask(bytes, NO_SIMD, mode)(blur->ptr<float>(),
+                    blur->pitch / 4, ref->data, ref->pitch / ob, opr, s,
+                    width, height, maxval, dref->ptr<int32_t>(),
+                    dref->pitch / 4);
+                get_emask(bytes, arch, mode)(bl->ptr<float>(), bl->pitch / 4,
+                    out->data, out->pitch / ob, opr, s, width, height, maxval,
+                    dout->ptr<int32_t>(), dout->pitch / 4);
+                const Tolerance tol = { 4, maxval * s / (1 << 18), 1 };
+                compare_as<float>(v, ob, what, *ref, *out, width, height, tol);
+                if (calcDir) {
+                    v.compare<int32_t>(what + " directions", *dref, *dout,
+                        width, height, EXACT, [&](int x, int y, int32_t dir) {
+                            return is_near_direction(*blur, opr, x, y, dir,
+                                maxval / (1 << 18));
+                        });
+                }
+            }
+        }
+
+        {
+            P em = v.plane(width * 4, height, true);
+            P dr = v.plane(width * 4, height, true);
+            copy_plane(*emask, *em, width * 4, height);
+            copy_plane(*dir, *dr, width * 4, height);
+            std::vector<uint32_t> hRef(NMS_HIST_BINS * NMS_HIST_LANES),
+                hOut(hRef.size());
+            const float binscale = NMS_HIST_BINS / (2.0f * maxval);
+
+            P ref = v.plane(width * 4, height, false);
+            P out = v.plane(width * 4, height, true);
+            get_nms(NO_SIMD)(emask->ptr<float>(), emask->pitch / 4,
+                dir->ptr<int32_t>(), dir->pitch / 4, ref->ptr<float>(),
+                ref->pitch / 4, width, height);
+            get_nms(arch)(em->ptr<float>(), em->pitch / 4, dr->ptr<int32_t>(),
+                dr->pitch / 4, out->ptr<float>(), out->pitch / 4, width, height);
+            v.compare<float>("nms" + a + depth, *ref, *out, width, height,
+                EXACT);
+
+            P href = v.plane(width * 4, height, false);
+            P hout = v.plane(width * 4, height, true);
+            get_nms_hist(NO_SIMD)(emask->ptr<float>(), emask->pitch / 4,
+                dir->ptr<int32_t>(), dir->pitch / 4, href->ptr<float>(),
+                href->pitch / 4, width, height, binscale, hRef.data());
+            get_nms_hist(arch)(em->ptr<float>(), em->pitch / 4,
+                dr->ptr<int32_t>(), dr->pitch / 4, hout->ptr<float>(),
+                hout->pitch / 4, width, height, binscale, hOut.data());
+            v.compare<float>("nms_hist" + a + depth, *href, *hout, width,
+                height, EXACT);
+            v.compare("nms_hist" + a + depth + " histogram", hRef, hOut);
+        }
+
+        {
+            int rows = std::min(height, v.random(1, 40));
+            std::vector<float> minRef(width), maxRef(width);
+            std::vector<float> minOut(width), maxOut(width);
+            get_tile_range(bytes, NO_SIMD)(srcRef->data, srcRef->pitch / bytes,
+                width, rows, minRef.data(), maxRef.data());
+            get_tile_range(bytes, arch)(src->data, src->pitch / bytes, width,
+                rows, minOut.data(), maxOut.data());
+            ++v.checks;
+            if (minRef != minOut || maxRef != maxOut) {
+                ++v.failures;
+                fprintf(stderr, "FAIL tile_range%s%s %dx%d\n", a.c_str(),
+                    depth.c_str(), width, rows);
+            }
+        }
+    }
+
+    // joint gradient of color. the other two planes are the blurred plane
+    // flipped vertically and horizontally.
+    {
+        P flip[2] = {
+            v.plane(width * 4, height, false), v.plane(width * 4, height, false),
+        };
+        for (int y = 0; y < height; ++y) {
+            auto row = blur->ptr<float>()
+                + static_cast<size_t>(y) * blur->pitch / 4;
+            auto v0 = flip[0]->ptr<float>()
+                + static_cast<size_t>(height - 1 - y) * flip[0]->pitch / 4;
+            auto v1 = flip[1]->ptr<float>()
+                + static_cast<size_t>(y) * flip[1]->pitch / 4;
+            for (int x = 0; x < width; ++x) {
+                v0[x] = row[x];
+                v1[width - 1 - x] = row[x];
+            }
+        }
+        const Plane* planes[] = { blur.get(), flip[0].get(), flip[1].get() };
+        const float* bp[] = {
+            blur->ptr<float>(), flip[0]->ptr<float>(), flip[1]->ptr<float>(),
+        };
+        operator_t opr;
+        operator_mode("1 3 2", opr);
+        const float s = 1.7f;
+
+        P ref = v.plane(width * 4, height, false);
+        P dref = v.plane(width * 4, height, false);
+        get_color_emask(NO_SIMD)(bp, blur->pitch / 4, ref->ptr<float>(),
+            ref->pitch / 4, opr, s, width, height, maxval,
+            dref->ptr<int32_t>(), dref->pitch / 4);
+        for (auto arch : opt.archs) {
+            if (arch == NO_SIMD) {
+                continue;
+            }
+            const std::string what = std::string("color_emask ") + a2s(arch)
+                + depth;
+            P out = v.plane(width * 4, height, true);
+            P dout = v.plane(width * 4, height, true);
+            get_color_emask(arch)(bp, blur->pitch / 4, out->ptr<float>(),
+                out->pitch / 4, opr, s, width, height, maxval,
+                dout->ptr<int32_t>(), dout->pitch / 4);
+            v.compare<float>(what, *ref, *out, width, height,
+                { 16, maxval * s / (1 << 16), 0 });
+            v.compare<int32_t>(what + " directions", *dref, *dout, width,
+                height, EXACT, [&](int x, int y, int32_t dir) {
+                    return is_near_color_direction(planes, opr, x, y, dir,
+                        maxval / (1 << 18));
+                });
+        }
+    }
+
+    // tiles that skip_flat would skip must be 0 in the output of the whole
+    // plane, and processRegions() must yield the output of the whole plane
+    // bit for bit, for canny and for an integer edge mask. the source is
+    // flat but for a few random rectangles, so that some tiles are skipped
+    // and the others may be split into several windows.
+    std::vector<float> part(img.size(), v.random(0, 255) / 255.0f);
+    for (int n = v.random(1, 3); n > 0; --n) {
+        int x0 = v.random(0, width - 1), y0 = v.random(0, height - 1);
+        int x1 = v.random(x0 + 1, width), y1 = v.random(y0 + 1, height);
+        for (int y = y0; y < y1; ++y) {
+            std::copy(&img[static_cast<size_t>(y) * width + x0],
+                &img[static_cast<size_t>(y) * width + x1],
+                &part[static_cast<size_t>(y) * width + x0]);
+        }
+    }
+    P flatSrc = v.plane(width * bytes, height, false);
+    if (bytes == 1) store_image<uint8_t>(part, width, height, maxval, *flatSrc);
+    if (bytes == 2) store_image<uint16_t>(part, width, height, maxval, *flatSrc);
+    if (bytes == 4) store_image<float>(part, width, height, maxval, *flatSrc);
+    for (auto arch : opt.archs) {
+        for (int canny = 0; canny < 2; ++canny) {
+            if (!canny && bytes == 4) {
+                continue;
+            }
+            CoreParams p{};
+            p.mode = operator_mode(canny ? "standard" : "sobel", p.opr)
+                | DETECT_EDGE | SKIP_FLAT | (canny ? CALC_DIRECTION
+                | GENERATE_CANNY_IMAGE | STRICT_MAGNITUDE : SCALE_MAGNITUDE);
+            p.arch = arch;
+            p.bits = bits;
+            p.maxval = maxval;
+            p.width = p.minWidth = width;
+            p.height = p.minHeight = height;
+            // radius of the blur is kept below the size of the plane, which
+            // it mirrors at the borders.
+            p.sigma = v.random(1, std::min(30,
+                (10 * std::min(width, height) - 6) / 3)) * 0.1f;
+            p.scale = canny ? 1.0f : 5.1f;
+            const int tl = v.random(1, 16);
+            p.tmin = { tl * maxval / 255 };
+            p.tmax = { tl * v.random(1, 8) * maxval / 255 };
+            TCannyCore core(p);
+            char what[96];
+            snprintf(what, sizeof(what), "%s %s%s sigma %.1f t_l %d",
+                canny ? "canny" : "emask", a2s(arch), depth.c_str(), p.sigma,
+                tl);
+
+            constexpr int tile = 16;
+            const int tw = (width + tile - 1) / tile;
+            std::vector<uint8_t> active(tw * ((height + tile - 1) / tile));
+            core.findActiveTiles(flatSrc->data, flatSrc->pitch / bytes, width,
+                height, tile, active.data());
+            Plane scratch(static_cast<int>(core.scratchSize()), 1);
+            P out = v.plane(width * bytes, height, false);
+            core.process(flatSrc->data, flatSrc->pitch / bytes, out->data,
+                out->pitch / bytes, width, height, scratch.data, nullptr);
+
+            ++v.checks;
+            int bad = 0;
+            for (int y = 0; y < height; ++y) {
+                auto row = out->data + static_cast<size_t>(y) * out->pitch;
+                for (int x = 0; x < width; ++x) {
+                    if (!active[y / tile * tw + x / tile]) {
+                        bad += std::any_of(row + x * bytes,
+                            row + (x + 1) * bytes, [](uint8_t b) { return b; });
+                    }
+                }
+            }
+            if (bad > 0) {
+                ++v.failures;
+                fprintf(stderr, "FAIL skip_flat %s %dx%d: %d pixels of "
+                    "skipped tiles are not 0\n", what, width, height, bad);
+            }
+
+            Plane window(static_cast<int>(core.windowSize(width, height)), 1);
+            P reg = v.plane(width * bytes, height, true);
+            core.processRegions(flatSrc->data, flatSrc->pitch / bytes,
+                reg->data, reg->pitch / bytes, width, height, nullptr, nullptr,
+                false, scratch.data, window.data, nullptr);
+            compare_as<float>(v, bytes, std::string("skip_flat regions ")
+                + what, *out, *reg, width, height, EXACT);
+        }
+    }
+
+    // hysteresis has only the C routines. the variants for edge chains,
+    // for counting and for temporal mode are compared with the plain one.
+    const float tl = 1.0f * maxval / 255, th = 8.0f * maxval / 255;
+    P ref = v.plane(width * bytes, height, false);
+    get_hysteresis(bytes)(ref->data, ref->pitch / bytes, nms->ptr<float>(),
+        nms->pitch / 4, width, height, tl, th, maxval, nullptr);
+    HysteresisStats hs{};
+    {
+        P out = v.plane(width * bytes, height, true);
+        get_hysteresis(bytes, true)(out->data, out->pitch / bytes,
+            nms->ptr<float>(), nms->pitch / 4, width, height, tl, th, maxval,
+            &hs);
+        compare_as<float>(v, bytes, "hysteresis_count" + depth, *ref, *out,
+            width, height, EXACT);
+    }
+    {
+        P out = v.plane(width * bytes, height, true);
+        EdgeChains ec{};
+        ec.record = true;
+        HysteresisStats chs{};
+        get_hysteresis_chain(bytes, true)(out->data, out->pitch / bytes,
+            nms->ptr<float>(), nms->pitch / 4, width, height, tl, th, maxval,
+            ec, &chs);
+        compare_as<float>(v, bytes, "hysteresis_chain" + depth, *ref, *out,
+            width, height, EXACT);
+        // every seed starts a chain, and every pixel of a chain but the
+        // seed is promoted.
+        int64_t pixels = 0;
+        for (auto n : ec.pixels) pixels += n;
+        ++v.checks;
+        if (chs.seeds != static_cast<int64_t>(ec.pixels.size())
+                || chs.seeds + chs.promoted != pixels
+                || chs.seeds != hs.seeds || chs.promoted != hs.promoted) {
+            ++v.failures;
+            fprintf(stderr, "FAIL hysteresis_stats%s %dx%d: counts do not "
+                "match the chains\n", depth.c_str(), width, height);
+        }
+    }
+    {
+        // the previous frame differs from nms only on the dirty rows.
+        P prev = v.plane(width * 4, height, false);
+        copy_plane(*nms, *prev, width * 4, height);
+        std::vector<uint8_t> dirty(height, 0);
+        int top = v.random(0, height - 1), bottom = v.random(top, height - 1);
+        for (int y = top; y <= bottom; ++y) {
+            dirty[y] = 1;
+            auto p = reinterpret_cast<float*>(prev->data
+                + static_cast<size_t>(y) * prev->pitch);
+            std::reverse(p, p + width);
+        }
+        P out = v.plane(width * bytes, height, true);
+        get_hysteresis(bytes)(out->data, out->pitch / bytes,
+            prev->ptr<float>(), prev->pitch / 4, width, height, tl, th, maxval,
+            nullptr);
+        get_hysteresis_update(bytes)(out->data, out->pitch / bytes,
+            nms->ptr<float>(), nms->pitch / 4, width, height, tl, th, maxval,
+            dirty.data());
+        compare_as<float>(v, bytes, "hysteresis_update" + depth, *ref, *out,
+            width, height, EXACT);
+    }
+    {
+        // morphology of the edge map, compared with the passes one by one.
+        const int expand = v.random(0, 4), inflate = v.random(0, 4);
+        P exp = v.plane(width * bytes, height, false);
+        P tmp = v.plane(width * bytes, height, false);
+        copy_plane(*ref, *exp, width * bytes, height);
+        for (int i = 0; i < expand + inflate; ++i) {
+            bool e = i < expand;
+            if (bytes == 1) morph_pass<uint8_t>(*exp, *tmp, width, height, e);
+            if (bytes == 2) morph_pass<uint16_t>(*exp, *tmp, width, height, e);
+            if (bytes == 4) morph_pass<float>(*exp, *tmp, width, height, e);
+            std::swap(exp, tmp);
+        }
+        P out = v.plane(width * bytes, height, true);
+        copy_plane(*ref, *out, width * bytes, height);
+        Plane buff(static_cast<int>(
+            morphology_size(bytes, width, expand, inflate)), 1);
+        get_morphology(bytes)(out->data, out->pitch / bytes, width, height,
+            expand, inflate, maxval, buff.data);
+        char ei[32];
+        snprintf(ei, sizeof(ei), " e%d i%d", expand, inflate);
+        compare_as<float>(v, bytes, "morphology" + depth + ei, *exp, *out,
+            width, height, EXACT);
+    }
+    {
+        // distance map of the edge map.
+        const int radius = v.random(1, 12);
+        P exp = v.plane(width * bytes, height, false);
+        if (bytes == 1) distance_ref<uint8_t>(*ref, *exp, width, height,
+            radius, maxval);
+        if (bytes == 2) distance_ref<uint16_t>(*ref, *exp, width, height,
+            radius, maxval);
+        if (bytes == 4) distance_ref<float>(*ref, *exp, width, height,
+            radius, maxval);
+        P out = v.plane(width * bytes, height, true);
+        copy_plane(*ref, *out, width * bytes, height);
+        Plane buff(static_cast<int>(distance_size(width, height)), 1);
+        get_distance(bytes)(out->data, out->pitch / bytes, width, height,
+            radius, maxval, buff.data);
+        compare_as<float>(v, bytes, "distance" + depth + " r"
+            + std::to_string(radius), *exp, *out, width, height, EXACT);
+    }
+}
+
+
+// fills each region with a byte of its own when the first stage in which it
+// is live begins, and then checks that all the regions live in the stage
+// still have their bytes. so a region written over by another one that is
+// live together is found, as well as by scratch_overlaps().
+static void check_scratch(Verifier& v, const std::string& what,
+    const std::vector<ScratchRegion>& regions, size_t total)
+{
+    ++v.checks;
+    std::vector<uint8_t> buf(total, 0);
+    int last = 0;
+    bool inside = true;
+    for (const auto& r : regions) {
+        last = std::max(last, r.last);
+        inside &= r.size == 0 || r.offset + r.size <= total;
+    }
+    const char* error = !inside ? "a region is beyond the buffer"
+        : scratch_overlaps(regions) ? "regions live together overlap"
+        : nullptr;
+    for (int stage = 0; stage <= last && !error; ++stage) {
+        for (size_t i = 0; i < regions.size(); ++i) {
+            const auto& r = regions[i];
+            if (r.size > 0 && r.first == stage) {
+                memset(buf.data() + r.offset, static_cast<int>(i + 1), r.size);
+            }
+        }
+        for (size_t i = 0; i < regions.size() && !error; ++i) {
+            const auto& r = regions[i];
+            if (r.size > 0 && r.first <= stage && stage <= r.last
+                && !std::all_of(buf.data() + r.offset,
+                    buf.data() + r.offset + r.size,
+                    [i](uint8_t b) { return b == i + 1; })) {
+                error = "a live region is written over";
+            }
+        }
+    }
+    if (error) {
+        ++v.failures;
+        fprintf(stderr, "FAIL scratch %s: %s\n", what.c_str(), error);
+    }
+}
+
+
+// the scratch regions of TCannyCore for the combinations of the modes of
+// the filters, and plan_scratch() for random regions.
+static void verify_scratch(Verifier& v, const Options& opt)
+{
+    const int canny = DETECT_EDGE | CALC_DIRECTION | GENERATE_CANNY_IMAGE;
+    const int modes[] = {
+        DO_BLUR_ONLY, DETECT_EDGE, DETECT_EDGE | DO_NOT_BLUR,
+        DETECT_EDGE | SKIP_FLAT, DETECT_EDGE | CALC_DIRECTION | SHOW_DIRECTION,
+        DETECT_EDGE | CALC_DIRECTION | OUTPUT_GRADIENT,
+        DO_NMS_ONLY | DO_NOT_BLUR, DO_HYSTERESIS_ONLY | DO_NOT_BLUR,
+    };
+    // options of canny, each of which is on or off.
+    const int options[] = {
+        DO_NOT_BLUR, TEMPORAL, SKIP_FLAT, JOINT_COLOR, AUTO_PERCENTILE,
+        DISTANCE_MAP, 1 << 30,  // expand and inflate
+    };
+    constexpr int numOptions = sizeof(options) / sizeof(options[0]);
+    std::vector<int> all(std::begin(modes), std::end(modes));
+    for (int set = 0; set < 1 << numOptions; ++set) {
+        int mode = canny;
+        for (int i = 0; i < numOptions; ++i) {
+            if (set >> i & 1) mode |= options[i];
+        }
+        all.push_back(mode);
+    }
+
+    for (int c = 0; c < opt.cases; ++c) {
+        // a plane, a wide and short plane, or a column.
+        const int sizes[][2] = {
+            { v.random(8, 300), v.random(8, 100) },
+            { v.random(1000, 4000), v.random(1, 8) },
+            { v.random(1, 4), v.random(1, 50) },
+        };
+        const int width = sizes[c % 3][0], height = sizes[c % 3][1];
+        const int bits = opt.bits[v.random(0,
+            static_cast<int>(opt.bits.size()) - 1)];
+        for (auto arch : opt.archs) {
+            for (int m : all) {
+                CoreParams p{};
+                p.mode = (m & ~(1 << 30)) | STRICT_MAGNITUDE
+                    | operator_mode("standard", p.opr);
+                p.arch = arch;
+                p.bits = bits;
+                p.maxval = bits == 32 ? 1.0f : 1.0f * (0xFF << (bits - 8));
+                p.width = width;
+                p.height = height;
+                p.minWidth = v.random(1, width);
+                p.minHeight = v.random(1, height);
+                p.sigma = v.random(1, 40) * 0.1f;
+                p.scale = 1.0f;
+                p.tmin = { 1.0f };
+                p.tmax = { 8.0f };
+                p.percentile = 80.0f;
+                p.ratio = 0.4f;
+                if (m & 1 << 30) {
+                    p.expand = v.random(0, 4);
+                    p.inflate = v.random(1, 4);
+                }
+                p.maxDistance = v.random(1, DISTANCE_MAX);
+                std::unique_ptr<TCannyCore> core;
+                try {
+                    core = std::make_unique<TCannyCore>(p);
+                } catch (std::exception&) {
+                    continue;   // a combination the filters reject
+                }
+                char what[96];
+                snprintf(what, sizeof(what), "mode %#x %s %d bits %dx%d", m,
+                    a2s(arch), bits, width, height);
+                check_scratch(v, what, core->getScratchRegions(),
+                    core->scratchSize());
+            }
+        }
+
+        // random regions, some of which are empty.
+        std::vector<ScratchRegion> regions(v.random(1, 8));
+        for (auto& r : regions) {
+            r.size = v.random(0, 3) == 0 ? 0 : v.random(1, 1 << 16);
+            r.first = v.random(0, 5);
+            r.last = v.random(r.first, 5);
+        }
+        size_t total = plan_scratch(regions, SCRATCH_ALIGN);
+        bool aligned = std::all_of(regions.begin(), regions.end(),
+            [](const ScratchRegion& r) { return r.offset % SCRATCH_ALIGN == 0; });
+        check_scratch(v, "random", regions, total);
+        ++v.checks;
+        if (!aligned) {
+            ++v.failures;
+            fprintf(stderr, "FAIL scratch random: an offset is not aligned\n");
+        }
+    }
+}
+
+
+static int run_verify(const Options& opt)
+{
+    Verifier v(opt.seed);
+    static const char* const images[] = { "noise", "shapes", "fbm" };
+
+    for (int i = 0; i < opt.cases; ++i) {
+        // widths are rarely multiples of the vector sizes.
+        int width = v.random(8, 300);
+        int height = v.random(8, 100);
+        auto img = make_image(images[i % 3], width, height);
+        for (int bits : opt.bits) {
+            verify_plane(v, opt, img, width, height, bits);
+        }
+    }
+    verify_scratch(v, opt);
+    fprintf(stderr, "%d checks, %d failures\n", v.checks, v.failures);
+    return v.failures > 0 ? 1 : 0;
+}
+
+
+static void write_json(FILE* fp, const Options& opt,
+    const std::vector<Result>& results)
+{
+    auto quote = [](const std::string& s) {
+        std::string q = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') q += '\\';
+            q += c;
+        }
+        return q + "\"";
+    };
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"version\": \"%s\",\n", TCANNY_M_VERSION);
+    fprintf(fp, "  \"cpu\": { \"sse41\": %s, \"avx2\": %s, \"avx512\": %s, "
+        "\"llc_bytes\": %zu },\n", has_sse41() ? "true" : "false",
+        has_avx2() ? "true" : "false", has_avx512() ? "true" : "false",
+        get_llc_size());
+    fprintf(fp, "  \"min_time\": %g,\n", opt.minTime);
+    fprintf(fp, "  \"pitch\": \"%s\",\n", opt.oddPitch ? "odd" : "aligned");
+    fprintf(fp, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        double pixels = static_cast<double>(r.width) * r.height;
+        fprintf(fp, "%s\n    { \"stage\": %s, \"arch\": %s, \"bits\": %d, "
+            "\"radius\": %d, \"operator\": %s, \"image\": %s, "
+            "\"width\": %d, \"height\": %d, \"iterations\": %d, "
+            "\"ns_per_frame\": %.0f, \"cycles_per_pixel\": %.4f, "
+            "\"gb_per_s\": %.3f, \"bytes_per_frame\": %zu }",
+            i == 0 ? "" : ",", quote(r.stage).c_str(), quote(r.arch).c_str(), r.bits,
+            r.radius, quote(r.op).c_str(), quote(r.image).c_str(), r.width,
+            r.height, r.iterations, r.ns, r.cycles / pixels,
+            r.bytes / r.ns, r.bytes);
+    }
+    fprintf(fp, "\n  ]\n}\n");
+}
+
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: tcanny_bench [options]\n"
+        "  --arch LIST       c,sse4,avx2,avx512 (default: all supported)\n"
+        "  --stage LIST      cvt2flt,gblur,gblur_src,emask,emask_dir,nms,\n"
+        "                    nms_hist,write_directions,hysteresis (default: all)\n"
+        "  --bits LIST       8,10,...,16,32 (default: 8,16,32)\n"
+        "  --radius LIST     radii of gaussian blur (default: 1,2,3)\n"
+        "  --operator LIST   standard,sobel,prewitt (default: all)\n"
+        "  --size LIST       480p,720p,1080p,4k,8k or WxH (default: all)\n"
+        "  --image LIST      noise,ramp,shapes,fbm,file:<pgm> (default: shapes,fbm)\n"
+        "  --pitch P         aligned: pitches of TCannyCore (multiples of 64),\n"
+        "                    odd: odd multiples of 64 (default: aligned)\n"
+        "  --min-time SEC    minimum time of each measurement (default: 0.1)\n"
+        "  --output FILE     write JSON to FILE instead of stdout\n"
+        "  --verify          compare every kernel of --arch with the C kernel on\n"
+        "                    random sizes and pitches (--bits default: 8,10,16,32)\n"
+        "                    instead of measuring. exits with 1 on mismatches\n"
+        "  --cases N         number of random sizes of --verify (default: 30)\n"
+        "  --seed N          seed of --verify (default: 1)\n");
+}
+
+
+static Options parse_options(int argc, char** argv)
+{
+    Options opt;
+    opt.stages.assign(std::begin(all_stages), std::end(all_stages));
+    opt.bits = { 8, 16, 32 };
+    opt.radii = { 1, 2, 3 };
+    opt.ops = { "standard", "sobel", "prewitt" };
+    for (const auto& s : all_sizes) opt.sizes.push_back(s.name);
+    opt.images = { "shapes", "fbm" };
+    opt.oddPitch = false;
+    opt.minTime = 0.1;
+    opt.verify = false;
+    opt.cases = 30;
+    opt.seed = 1;
+    bool bits = false;
+
+    opt.archs.push_back(NO_SIMD);
+    if (has_sse41()) opt.archs.push_back(USE_SSE4);
+    if (has_avx2()) opt.archs.push_back(USE_AVX2);
+    if (has_avx512()) opt.archs.push_back(USE_AVX512);
+
+    auto ints = [](const std::string& s) {
+        std::vector<int> v;
+        for (const auto& t : split(s, ",")) v.push_back(std::stoi(t));
+        return v;
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--help" || a == "-h") {
+            usage();
+            exit(0);
+        }
+        if (a == "--verify") {
+            opt.verify = true;
+            continue;
+        }
+        validate(i + 1 >= argc, ("missing value of " + a).c_str());
+        std::string v = argv[++i];
+        if (a == "--arch") {
+            opt.archs.clear();
+            for (const auto& t : split(v, ",")) {
+                arch_t arch = t == "c" ? NO_SIMD : t == "sse4" ? USE_SSE4
+                    : t == "avx2" ? USE_AVX2 : USE_AVX512;
+                validate(get_arch(static_cast<int>(arch)) != arch,
+                    (t + " is not supported by this cpu.").c_str());
+                opt.archs.push_back(arch);
+            }
+        } else if (a == "--stage") {
+            opt.stages = split(v, ",");
+            for (const auto& s : opt.stages) {
+                validate(std::find(std::begin(all_stages), std::end(all_stages),
+                    s) == std::end(all_stages), ("unknown stage " + s).c_str());
+            }
+        } else if (a == "--bits") {
+            opt.bits = ints(v);
+            bits = true;
+            for (int b : opt.bits) {
+                validate(b != 32 && (b < 8 || b > 16), "invalid bits.");
+            }
+        } else if (a == "--radius") {
+            opt.radii = ints(v);
+            for (int r : opt.radii) {
+                validate(r < 1, "invalid radius.");
+            }
+        } else if (a == "--operator") {
+            opt.ops = split(v, ",");
+        } else if (a == "--size") {
+            opt.sizes = split(v, ",");
+        } else if (a == "--image") {
+            opt.images = split(v, ",");
+        } else if (a == "--pitch") {
+            validate(v != "odd" && v != "aligned", "pitch must be odd or aligned.");
+            opt.oddPitch = v == "odd";
+        } else if (a == "--min-time") {
+            opt.minTime = std::stod(v);
+        } else if (a == "--output") {
+            opt.output = v;
+        } else if (a == "--cases") {
+            opt.cases = std::stoi(v);
+        } else if (a == "--seed") {
+            opt.seed = static_cast<unsigned>(std::stoul(v));
+        } else {
+            throw std::runtime_error(("unknown option " + a).c_str());
+        }
+    }
+    if (opt.verify && !bits) {
+        opt.bits = { 8, 10, 16, 32 };
+    }
+    return opt;
+}
+
+
+static void get_size(const std::string& s, int& width, int& height)
+{
+    for (const auto& t : all_sizes) {
+        if (s == t.name) {
+            width = t.width;
+            height = t.height;
+            return;
+        }
+    }
+    auto v = split(s, "x");
+    validate(v.size() != 2, ("invalid size " + s).c_str());
+    width = std::stoi(v[0]);
+    height = std::stoi(v[1]);
+    validate(width < 16 || height < 16, ("too small size " + s).c_str());
+}
+
+
+int main(int argc, char** argv)
+{
+    try {
+        auto opt = parse_options(argc, argv);
+        if (opt.verify) {
+            return run_verify(opt);
+        }
+
+        std::vector<Result> results;
+        for (const auto& size : opt.sizes) {
+            int width = 0, height = 0;
+            get_size(size, width, height);
+            for (const auto& image : opt.images) {
+                auto img = make_image(image, width, height);
+                for (int bits : opt.bits) {
+                    bench_plane(opt, image, img, width, height, bits, results);
+                }
+            }
+        }
+
+        FILE* fp = stdout;
+        if (!opt.output.empty()) {
+            fp = fopen(opt.output.c_str(), "w");
+            validate(!fp, ("cannot open " + opt.output).c_str());
+        }
+        write_json(fp, opt, results);
+        if (fp != stdout) {
+            fclose(fp);
+        }
+
+    } catch (std::exception& e) {
+        fprintf(stderr, "tcanny_bench: %s\n", e.what());
+        usage();
+        return 1;
+    }
+    return 0;
+}
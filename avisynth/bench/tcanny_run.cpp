@@ -0,0 +1,760 @@
+/*
+  tcanny_run.cpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+// runs the filters over a y4m or raw planar file without AviSynth, and
+// reports the throughput and the latency of each stage.
+// frames are processed by a pool of threads, each of which has its own
+// scratch buffer, and the output is written in order.
+
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <xmmintrin.h>
+#include "tcanny.h"
+#include "tcanny_core.hpp"
+#include "utils.hpp"
+
+
+struct Format {
+    int bits;
+    int ssw;        // log2 of horizontal chroma subsampling
+    int ssh;
+    bool mono;
+};
+
+// y4m colorspace tags: 420jpeg, 420p10, 422, 444p16, mono, mono16, etc.
+static Format parse_format(const std::string& tag)
+{
+    Format f{ 8, 0, 0, false };
+    std::string rest;
+    if (tag.rfind("mono", 0) == 0) {
+        f.mono = true;
+        rest = tag.substr(4);
+        if (!rest.empty()) f.bits = std::stoi(rest);
+        rest.clear();
+    } else if (tag.rfind("420", 0) == 0) {
+        f.ssw = f.ssh = 1;
+        rest = tag.substr(3);
+    } else if (tag.rfind("422", 0) == 0) {
+        f.ssw = 1;
+        rest = tag.substr(3);
+    } else if (tag.rfind("444", 0) == 0) {
+        rest = tag.substr(3);
+    } else if (tag.rfind("411", 0) == 0) {
+        f.ssw = 2;
+        rest = tag.substr(3);
+    } else {
+        throw std::runtime_error("unsupported colorspace " + tag);
+    }
+    if (rest.size() > 1 && rest[0] == 'p') {
+        f.bits = std::stoi(rest.substr(1));
+    }
+    validate(f.bits < 8 || f.bits > 16, "unsupported bit depth.");
+    return f;
+}
+
+
+struct Input {
+    const uint8_t* base;
+    size_t size;
+    int width;
+    int height;
+    Format fmt;
+    std::string params;         // other tags of the y4m header
+    std::vector<size_t> frames; // offsets of the frame data
+    int planeWidth[3];
+    int planeHeight[3];
+    size_t frameSize;
+
+    Input() : base(nullptr), size(0), width(0), height(0), fmt(),
+        planeWidth(), planeHeight(), frameSize(0) {}
+    ~Input()
+    {
+        if (base) {
+            munmap(const_cast<uint8_t*>(base), size);
+        }
+    }
+    int bytes() const { return fmt.bits > 8 ? 2 : 1; }
+    int numPlanes() const { return fmt.mono ? 1 : 3; }
+    void setPlanes()
+    {
+        validate(width < 1 || height < 1, "invalid frame size.");
+        frameSize = 0;
+        for (int p = 0; p < numPlanes(); ++p) {
+            planeWidth[p] = p == 0 ? width : width >> fmt.ssw;
+            planeHeight[p] = p == 0 ? height : height >> fmt.ssh;
+            frameSize += static_cast<size_t>(planeWidth[p]) * planeHeight[p]
+                * bytes();
+        }
+    }
+};
+
+
+static void map_file(const char* path, Input& in)
+{
+    int fd = open(path, O_RDONLY);
+    validate(fd < 0, (std::string("cannot open ") + path).c_str());
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw std::runtime_error(std::string("cannot read ") + path);
+    }
+    in.size = static_cast<size_t>(st.st_size);
+    void* p = mmap(nullptr, in.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    validate(p == MAP_FAILED, (std::string("cannot map ") + path).c_str());
+    madvise(p, in.size, MADV_SEQUENTIAL);
+    in.base = reinterpret_cast<const uint8_t*>(p);
+}
+
+
+static void open_y4m(const char* path, Input& in)
+{
+    map_file(path, in);
+    auto end = static_cast<const uint8_t*>(memchr(in.base, '\n', in.size));
+    validate(!end || memcmp(in.base, "YUV4MPEG2 ", 10) != 0,
+        "not a y4m file.");
+    std::string header(reinterpret_cast<const char*>(in.base) + 10,
+        reinterpret_cast<const char*>(end));
+
+    std::string tag = "420jpeg";
+    for (const auto& t : split(header, " ")) {
+        if (t[0] == 'W') in.width = std::stoi(t.substr(1));
+        else if (t[0] == 'H') in.height = std::stoi(t.substr(1));
+        else if (t[0] == 'C') tag = t.substr(1);
+        else if (t[0] == 'F' || t[0] == 'A' || t[0] == 'I') in.params += " " + t;
+    }
+    in.fmt = parse_format(tag);
+    in.setPlanes();
+
+    // each frame has its own header, which may have parameters.
+    size_t pos = end - in.base + 1;
+    while (pos + 6 <= in.size && memcmp(in.base + pos, "FRAME", 5) == 0) {
+        auto nl = static_cast<const uint8_t*>(
+            memchr(in.base + pos, '\n', in.size - pos));
+        if (!nl) break;
+        pos = nl - in.base + 1;
+        if (pos + in.frameSize > in.size) break;
+        in.frames.push_back(pos);
+        pos += in.frameSize;
+    }
+}
+
+
+// spec is WxH:FORMAT, where FORMAT is a y4m colorspace tag.
+static void open_raw(const char* path, const std::string& spec, Input& in)
+{
+    auto v = split(spec, ":");
+    validate(v.size() != 2, "--raw must be WxH:FORMAT.");
+    auto wh = split(v[0], "x");
+    validate(wh.size() != 2, "--raw must be WxH:FORMAT.");
+    in.width = std::stoi(wh[0]);
+    in.height = std::stoi(wh[1]);
+    in.fmt = parse_format(v[1]);
+    in.params = " F25:1 Ip A1:1";
+    in.setPlanes();
+
+    map_file(path, in);
+    for (size_t pos = 0; pos + in.frameSize <= in.size; pos += in.frameSize) {
+        in.frames.push_back(pos);
+    }
+}
+
+
+struct Options {
+    std::string input;
+    std::string raw;
+    std::string output;
+    std::string json;
+    int filter;
+    tcm_params params;
+    std::vector<float> tl;
+    std::vector<float> th;
+    std::string op;
+    int chroma;
+    int threads;
+    int warmup;
+    int maxFrames;
+    bool perf;
+};
+
+
+enum {
+    T_LOAD = NUM_STAGES,    // copy of the source into aligned planes
+    T_STORE,                // chroma and packing of the output
+    T_TOTAL,                // latency of the frame
+    NUM_TIMES,
+};
+
+static const char* const time_names[NUM_TIMES] = {
+    "blur", "emask", "nms", "hysteresis", "load", "store", "total",
+};
+
+using FrameTimes = std::array<int64_t, NUM_TIMES>;
+
+// hardware counts of each stage, summed over frames and threads.
+struct PerfTotals {
+    bool available;
+    int64_t pixels;
+    uint64_t counts[NUM_STAGES][NUM_PERF_EVENTS];
+
+    void add(const PerfTotals& o)
+    {
+        available |= o.available;
+        pixels += o.pixels;
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+                counts[s][e] += o.counts[s][e];
+            }
+        }
+    }
+};
+
+
+// buffers of a worker thread.
+struct Worker {
+    std::vector<uint8_t*> src;
+    std::vector<uint8_t*> dst;
+    std::vector<int> spitch;    // in bytes
+    std::vector<int> dpitch;
+    void* scratch;
+    uint8_t* window;            // windows of skip_flat, after the scratch
+
+    Worker(const Input& in, const TCannyCore& core, bool skipFlat) :
+        scratch(nullptr), window(nullptr)
+    {
+        const int numOut = core.numOutputs();
+        for (int p = 0; p < in.numPlanes(); ++p) {
+            int rowsize = in.planeWidth[p] * in.bytes();
+            int pitch = static_cast<int>(plan_pitch(rowsize, SCRATCH_ALIGN));
+            size_t h = in.planeHeight[p];
+            spitch.push_back(pitch);
+            dpitch.push_back(pitch);
+            src.push_back(alloc(pitch * h));
+            dst.push_back(alloc(pitch * h * numOut));
+        }
+        const size_t offset = (core.scratchSize() + SCRATCH_ALIGN - 1)
+            / SCRATCH_ALIGN * SCRATCH_ALIGN;
+        const size_t windowSize = skipFlat
+            ? core.windowSize(in.width, in.height) : 0;
+        scratch = alloc(offset + windowSize);
+        if (skipFlat) {
+            window = reinterpret_cast<uint8_t*>(scratch) + offset;
+        }
+    }
+    ~Worker()
+    {
+        for (auto p : src) _mm_free(p);
+        for (auto p : dst) _mm_free(p);
+        _mm_free(scratch);
+    }
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    static uint8_t* alloc(size_t size)
+    {
+        void* p = _mm_malloc(std::max(size, size_t(1)), SCRATCH_ALIGN);
+        validate(!p, "failed to allocate a buffer.");
+        return reinterpret_cast<uint8_t*>(p);
+    }
+};
+
+
+class Runner {
+    const Options& opt;
+    const Input& in;
+    const TCannyCore& core;
+    int numOut;
+    int outPlanes;
+    size_t outSize;
+
+    void processFrame(Worker& w, int n, std::vector<uint8_t>* out,
+        FrameTimes& times, PerfTotals& perf);
+
+public:
+    Runner(const Options& o, const Input& i, const TCannyCore& c) :
+        opt(o), in(i), core(c), numOut(c.numOutputs())
+    {
+        // chroma=0 leaves chroma untouched, so only luma is written.
+        outPlanes = opt.chroma == 0 ? 1 : in.numPlanes();
+        outSize = 0;
+        for (int p = 0; p < outPlanes; ++p) {
+            outSize += static_cast<size_t>(in.planeWidth[p]) * in.bytes()
+                * in.planeHeight[p] * numOut;
+        }
+    }
+    int outputPlanes() const { return outPlanes; }
+    int outputHeight() const { return in.height * numOut; }
+    void run(int frames, FILE* fp, std::vector<FrameTimes>* times,
+        PerfTotals* perf, double& seconds);
+};
+
+
+void Runner::processFrame(Worker& w, int n, std::vector<uint8_t>* out,
+    FrameTimes& times, PerfTotals& perf)
+{
+    using namespace std::chrono;
+    auto elapsed = [](steady_clock::time_point t) {
+        return duration_cast<nanoseconds>(steady_clock::now() - t).count();
+    };
+    const int bytes = in.bytes();
+    const uint8_t* frame = in.base + in.frames[n % in.frames.size()];
+
+    auto start = steady_clock::now();
+    const uint8_t* s = frame;
+    for (int p = 0; p < in.numPlanes(); ++p) {
+        int rowsize = in.planeWidth[p] * bytes;
+        for (int y = 0; y < in.planeHeight[p]; ++y) {
+            memcpy(w.src[p] + static_cast<size_t>(y) * w.spitch[p], s, rowsize);
+            s += rowsize;
+        }
+    }
+    times[T_LOAD] = elapsed(start);
+
+    PlaneResult res{};
+    res.timing = true;
+    res.perf = opt.perf ? get_perf_counters() : nullptr;
+    for (int p = 0; p < outPlanes; ++p) {
+        if (p == 0 || opt.chroma == 1) {
+            if (w.window) {
+                core.processRegions(w.src[p], w.spitch[p] / bytes, w.dst[p],
+                    w.dpitch[p] / bytes, in.planeWidth[p], in.planeHeight[p],
+                    nullptr, nullptr, false, w.scratch, w.window, &res);
+            } else {
+                core.process(w.src[p], w.spitch[p] / bytes, w.dst[p],
+                    w.dpitch[p] / bytes, in.planeWidth[p], in.planeHeight[p],
+                    w.scratch, &res);
+            }
+            perf.pixels += static_cast<int64_t>(in.planeWidth[p])
+                * in.planeHeight[p];
+        }
+    }
+    for (int i = 0; i < NUM_STAGES; ++i) {
+        times[i] = res.stageNs[i];
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+            perf.counts[i][e] += res.perfCounts[i][e];
+        }
+    }
+    perf.available |= res.perf != nullptr;
+
+    auto store = steady_clock::now();
+    for (int p = 1; p < outPlanes; ++p) {
+        size_t size = static_cast<size_t>(w.dpitch[p]) * in.planeHeight[p];
+        if (opt.chroma == 2) {
+            for (int t = 0; t < numOut; ++t) {
+                memcpy(w.dst[p] + t * size, w.src[p], size);
+            }
+        } else if (opt.chroma == 3) {
+            std::fill_n(reinterpret_cast<uint32_t*>(w.dst[p]),
+                size * numOut / sizeof(uint32_t), get_halfvalue(in.fmt.bits));
+        } else if (opt.chroma == 4) {
+            memset(w.dst[p], 0, size * numOut);
+        }
+    }
+    if (out) {
+        out->resize(outSize);
+        uint8_t* d = out->data();
+        for (int p = 0; p < outPlanes; ++p) {
+            int rowsize = in.planeWidth[p] * bytes;
+            for (int y = 0; y < in.planeHeight[p] * numOut; ++y) {
+                memcpy(d, w.dst[p] + static_cast<size_t>(y) * w.dpitch[p],
+                    rowsize);
+                d += rowsize;
+            }
+        }
+    }
+    times[T_STORE] = elapsed(store);
+    times[T_TOTAL] = elapsed(start);
+}
+
+
+// frames are taken by the workers in order, and at most depth frames can
+// be in flight, so that the output is written in order with bounded memory.
+void Runner::run(int frames, FILE* fp, std::vector<FrameTimes>* times,
+    PerfTotals* perf, double& seconds)
+{
+    const int depth = opt.threads * 2;
+    std::vector<std::vector<uint8_t>> slots(depth);
+    std::vector<char> ready(depth, 0);
+    std::mutex mtx;
+    std::condition_variable cv;
+    int next = 0, written = 0;
+    std::exception_ptr error;
+
+    if (times) {
+        times->assign(frames, FrameTimes{});
+    }
+
+    auto work = [&] {
+        try {
+            Worker w(in, core, opt.params.skip_flat != 0);
+            FrameTimes t{};
+            PerfTotals pt{};
+            while (true) {
+                int n;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&] {
+                        return next >= frames || next < written + depth;
+                    });
+                    if (next >= frames || error) {
+                        if (perf) {
+                            perf->add(pt);
+                        }
+                        return;
+                    }
+                    n = next++;
+                }
+                processFrame(w, n, fp ? &slots[n % depth] : nullptr, t, pt);
+                if (times) {
+                    (*times)[n] = t;
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                ready[n % depth] = 1;
+                cv.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            error = std::current_exception();
+            next = frames;
+            cv.notify_all();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int i = 0; i < opt.threads; ++i) {
+        pool.emplace_back(work);
+    }
+    for (int n = 0; n < frames; ++n) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return ready[n % depth] || error; });
+        if (error) {
+            break;
+        }
+        lock.unlock();
+        if (fp) {
+            const auto& s = slots[n % depth];
+            fputs("FRAME\n", fp);
+            fwrite(s.data(), 1, s.size(), fp);
+        }
+        lock.lock();
+        ready[n % depth] = 0;
+        ++written;
+        cv.notify_all();
+    }
+    for (auto& t : pool) {
+        t.join();
+    }
+    seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
+static double percentile(std::vector<int64_t>& v, double pct)
+{
+    if (v.empty()) {
+        return 0.0;
+    }
+    size_t i = std::min(v.size() - 1,
+        static_cast<size_t>(pct / 100.0 * v.size()));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i] * 1e-6;
+}
+
+
+static void report(const Options& opt, const Input& in,
+    const std::vector<FrameTimes>& times, const PerfTotals& perf,
+    double seconds)
+{
+    const size_t frames = times.size();
+    const double fps = frames / seconds;
+    const double mpx = fps * in.width * in.height * 1e-6;
+
+    FILE* js = nullptr;
+    if (!opt.json.empty()) {
+        js = fopen(opt.json.c_str(), "w");
+        validate(!js, ("cannot open " + opt.json).c_str());
+        fprintf(js, "{\n  \"version\": \"%s\",\n  \"frames\": %zu,\n"
+            "  \"threads\": %d,\n  \"width\": %d,\n  \"height\": %d,\n"
+            "  \"bits\": %d,\n  \"seconds\": %.6f,\n  \"fps\": %.3f,\n"
+            "  \"stages\": {", TCANNY_M_VERSION, frames, opt.threads,
+            in.width, in.height, in.fmt.bits, seconds, fps);
+    }
+
+    fprintf(stderr, "%zu frames, %d threads, %.3f s, %.2f fps, %.1f Mpx/s\n",
+        frames, opt.threads, seconds, fps, mpx);
+    fprintf(stderr, "%-11s %9s %9s %9s %9s %9s  (ms per frame)\n", "stage",
+        "mean", "p50", "p90", "p99", "max");
+    for (int i = 0; i < NUM_TIMES; ++i) {
+        std::vector<int64_t> v(frames);
+        double sum = 0.0;
+        for (size_t n = 0; n < frames; ++n) {
+            v[n] = times[n][i];
+            sum += v[n];
+        }
+        double mean = frames ? sum / frames * 1e-6 : 0.0;
+        double p50 = percentile(v, 50), p90 = percentile(v, 90),
+            p99 = percentile(v, 99), max = percentile(v, 100);
+        fprintf(stderr, "%-11s %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+            time_names[i], mean, p50, p90, p99, max);
+        if (js) {
+            fprintf(js, "%s\n    \"%s\": { \"mean_ms\": %.6f, \"p50_ms\": %.6f, "
+                "\"p90_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f }",
+                i == 0 ? "" : ",", time_names[i], mean, p50, p90, p99, max);
+        }
+    }
+    if (js) {
+        fprintf(js, "\n  }");
+    }
+
+    if (opt.perf && !perf.available) {
+        fprintf(stderr, "hardware counters are not available.\n");
+    } else if (opt.perf) {
+        if (js) {
+            fprintf(js, ",\n  \"perf\": {");
+        }
+        fprintf(stderr, "%-11s %9s %9s %9s %9s  (misses per pixel)\n", "stage",
+            "ipc", "l1d", "llc", "branch");
+        const double px = std::max<double>(1.0, perf.pixels);
+        for (int i = 0; i < NUM_STAGES; ++i) {
+            const auto& c = perf.counts[i];
+            double ipc = c[EV_CYCLES] ? 1.0 * c[EV_INSTRUCTIONS] / c[EV_CYCLES]
+                : 0.0;
+            double l1d = c[EV_L1D_MISSES] / px, llc = c[EV_LLC_MISSES] / px,
+                br = c[EV_BRANCH_MISSES] / px;
+            fprintf(stderr, "%-11s %9.3f %9.4f %9.4f %9.4f\n", time_names[i],
+                ipc, l1d, llc, br);
+            if (js) {
+                fprintf(js, "%s\n    \"%s\": { \"ipc\": %.6f, "
+                    "\"l1d_miss_px\": %.6f, \"llc_miss_px\": %.6f, "
+                    "\"branch_miss_px\": %.6f }", i == 0 ? "" : ",",
+                    time_names[i], ipc, l1d, llc, br);
+            }
+        }
+        if (js) {
+            fprintf(js, "\n  }");
+        }
+    }
+    if (js) {
+        fprintf(js, "\n}\n");
+        fclose(js);
+    }
+}
+
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: tcanny_run [options] INPUT\n"
+        "  INPUT is a y4m file, or a raw planar file with --raw.\n"
+        "  --raw WxH:FORMAT      FORMAT is a y4m colorspace (420, 422p10, mono16, ...)\n"
+        "  --filter NAME         tcannymod, gblur2, emask, dirmap or distmap\n"
+        "                        (default: tcannymod)\n"
+        "  --sigma F --t_l LIST --t_h LIST --operator S --scale F --strict 0|1\n"
+        "  --chroma N --opt N --minlen N --auto_threshold N --percentile F --ratio F\n"
+        "  --radius N --skip_flat 0|1\n"
+        "                        same as the arguments of the filter\n"
+        "  --threads N           worker threads (default: number of cpus)\n"
+        "  --warmup N            frames processed before measuring (default: 8)\n"
+        "  --frames N            number of frames to measure (default: all)\n"
+        "  --output FILE         write y4m (default: output is discarded)\n"
+        "  --json FILE           write the timings as JSON\n"
+        "  --perf 0|1            read hardware counters of each stage (Linux)\n");
+}
+
+
+static Options parse_options(int argc, char** argv)
+{
+    Options opt{};
+    opt.filter = TCM_FILTER_CANNY;
+    opt.threads = std::max(1u, std::thread::hardware_concurrency());
+    opt.warmup = 8;
+    opt.maxFrames = -1;
+    opt.chroma = -1;
+
+    std::vector<std::pair<std::string, std::string>> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--help" || a == "-h") {
+            usage();
+            exit(0);
+        }
+        if (a.rfind("--", 0) != 0) {
+            validate(!opt.input.empty(), "only one input can be given.");
+            opt.input = a;
+            continue;
+        }
+        validate(i + 1 >= argc, ("missing value of " + a).c_str());
+        args.emplace_back(a.substr(2), argv[++i]);
+    }
+    validate(opt.input.empty(), "no input.");
+
+    // the defaults of the filter are set before the other arguments.
+    for (const auto& [k, v] : args) {
+        if (k == "filter") {
+            opt.filter = v == "tcannymod" ? TCM_FILTER_CANNY
+                : v == "gblur2" ? TCM_FILTER_GBLUR
+                : v == "emask" ? TCM_FILTER_EMASK
+                : v == "dirmap" ? TCM_FILTER_DIRMAP
+                : v == "distmap" ? TCM_FILTER_DISTMAP : -1;
+            validate(opt.filter < 0, ("unknown filter " + v).c_str());
+        }
+    }
+    tcm_params_default(&opt.params, opt.filter);
+    auto& p = opt.params;
+    auto floats = [](const std::string& s) {
+        std::vector<float> f;
+        for (const auto& t : split(s, ",")) f.push_back(std::stof(t));
+        return f;
+    };
+
+    for (const auto& [k, v] : args) {
+        if (k == "filter") continue;
+        else if (k == "raw") opt.raw = v;
+        else if (k == "output") opt.output = v;
+        else if (k == "json") opt.json = v;
+        else if (k == "threads") opt.threads = std::stoi(v);
+        else if (k == "warmup") opt.warmup = std::stoi(v);
+        else if (k == "frames") opt.maxFrames = std::stoi(v);
+        else if (k == "perf") opt.perf = std::stoi(v) != 0;
+        else if (k == "sigma") p.sigma = std::stof(v);
+        else if (k == "t_l") opt.tl = floats(v);
+        else if (k == "t_h") opt.th = floats(v);
+        else if (k == "operator") opt.op = v;
+        else if (k == "scale") p.scale = std::stof(v);
+        else if (k == "strict") p.strict = std::stoi(v);
+        else if (k == "chroma") opt.chroma = std::stoi(v);
+        else if (k == "opt") p.opt = std::stoi(v);
+        else if (k == "minlen") p.minlen = std::stoi(v);
+        else if (k == "auto_threshold") p.auto_threshold = std::stoi(v);
+        else if (k == "percentile") p.percentile = std::stof(v);
+        else if (k == "ratio") p.ratio = std::stof(v);
+        else if (k == "radius") p.radius = std::stoi(v);
+        else if (k == "skip_flat") p.skip_flat = std::stoi(v);
+        else throw std::runtime_error("unknown option --" + k);
+    }
+    validate(opt.threads < 1, "threads must be greater than 0.");
+    validate(opt.warmup < 0, "warmup must not be negative.");
+    if (opt.chroma < 0) {
+        opt.chroma = opt.filter == TCM_FILTER_EMASK ? 1 : 0;
+    }
+    validate(opt.chroma < 0 || opt.chroma > 4, "chroma must be 0, 1, 2, 3 or 4");
+    return opt;
+}
+
+
+int main(int argc, char** argv)
+{
+    try {
+        auto opt = parse_options(argc, argv);
+
+        Input in;
+        if (opt.raw.empty()) {
+            open_y4m(opt.input.c_str(), in);
+        } else {
+            open_raw(opt.input.c_str(), opt.raw, in);
+        }
+        validate(in.frames.empty(), "input has no frame.");
+        if (in.fmt.mono) {
+            opt.chroma = 0;
+        }
+
+        auto& p = opt.params;
+        p.bits = in.fmt.bits;
+        p.width = in.width;
+        p.height = in.height;
+        if (opt.chroma == 1) {
+            p.min_width = in.planeWidth[1];
+            p.min_height = in.planeHeight[1];
+        }
+        if (!opt.op.empty()) p.op = opt.op.c_str();
+        if (!opt.tl.empty() || !opt.th.empty()) {
+            if (opt.tl.empty()) opt.tl = { 1.0f };
+            if (opt.th.empty()) opt.th = { 8.0f };
+            check_thresholds(opt.tl, opt.th);
+            p.t_l = opt.tl.data();
+            p.t_h = opt.th.data();
+            p.num_thresholds = static_cast<int>(opt.tl.size());
+        }
+        TCannyCore core(get_core_params(p));
+        Runner runner(opt, in, core);
+
+        int frames = static_cast<int>(in.frames.size());
+        if (opt.maxFrames > 0) {
+            frames = std::min(frames, opt.maxFrames);
+        }
+
+        double seconds = 0.0;
+        if (opt.warmup > 0) {
+            runner.run(opt.warmup, nullptr, nullptr, nullptr, seconds);
+        }
+
+        FILE* fp = nullptr;
+        if (!opt.output.empty()) {
+            fp = fopen(opt.output.c_str(), "wb");
+            validate(!fp, ("cannot open " + opt.output).c_str());
+            std::string tag = in.fmt.mono || runner.outputPlanes() == 1
+                ? "mono" : in.fmt.ssw == 2 ? "411"
+                : in.fmt.ssh ? "420" : in.fmt.ssw ? "422" : "444";
+            if (in.fmt.bits > 8) {
+                if (tag != "mono") tag += 'p';
+                tag += std::to_string(in.fmt.bits);
+            }
+            fprintf(fp, "YUV4MPEG2 W%d H%d%s C%s\n", in.width,
+                runner.outputHeight(), in.params.c_str(), tag.c_str());
+        }
+
+        std::vector<FrameTimes> times;
+        PerfTotals perf{};
+        runner.run(frames, fp, &times, &perf, seconds);
+        if (fp) {
+            fclose(fp);
+        }
+        report(opt, in, times, perf, seconds);
+
+    } catch (std::exception& e) {
+        fprintf(stderr, "tcanny_run: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
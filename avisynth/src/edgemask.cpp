@@ -25,10 +25,9 @@
 
 #include <type_traits>
 #include <algorithm>
+#include <cmath>
 #include <cstring>
-#include <format>
-#include <unordered_map>
-#include "tcannymod.hpp"
+#include "tcanny_core.hpp"
 #include "edgemask.hpp"
 
 
@@ -131,7 +130,9 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, operator_t& opr,
             if constexpr (SCALE) {
                 magnitude *= scale;
             }
-            if (!CALC_DIR) {
+            if constexpr (CALC_DIR) {
+                magnitude = std::min(magnitude, maxval);
+            } else {
                 magnitude = std::clamp(magnitude + ro, 0.0f, maxval);
             }
             d[x] = static_cast<Td>(magnitude);
@@ -145,6 +146,67 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, operator_t& opr,
         }
     }
     memset(d, 0, dpitch * sizeof(Td));
+    if constexpr (CALC_DIR) {
+        memset(dirp, 0, dirpitch * sizeof(int32_t));
+    }
+}
+
+
+// joint gradient of three planes (Di Zenzo). the magnitude is the square
+// root of the largest eigenvalue of the structure tensor, and the direction
+// is its eigenvector, which is the gradient itself for a single plane.
+static void
+color_emask(const float* const* blurp, int blpitch, float* dstp, int dpitch,
+    operator_t& opr, float scale, int width, int height, float maxval,
+    int32_t* dirp, int dirpitch)
+{
+    const float k0 = opr[0];
+    const float k1 = opr[1];
+    const float k2 = opr[2];
+    memset(dstp, 0, dpitch * sizeof(float));
+    memset(dirp, 0, dirpitch * sizeof(int32_t));
+    dstp += dpitch;
+    dirp += dirpitch;
+
+    for (int y = 1; y < height - 1; ++y) {
+        dstp[0] = 0;
+        dirp[0] = 0;
+
+        for (int x = 1; x < width - 1; ++x) {
+            int L = x - 1, R = x + 1;
+            float gxx = 0.0f, gyy = 0.0f, gxy = 0.0f;
+            for (int p = 0; p < 3; ++p) {
+                const float* above = blurp[p] + static_cast<size_t>(y - 1) * blpitch;
+                const float* centr = above + blpitch;
+                const float* below = centr + blpitch;
+                float gx = above[R] * k0 + centr[R] * k1 + below[R] * k2 -
+                    (above[L] * k0 + centr[L] * k1 + below[L] * k2);
+                float gy = above[L] * k0 + above[x] * k1 + above[R] * k2 -
+                    (below[L] * k0 + below[x] * k1 + below[R] * k2);
+                gxx += gx * gx;
+                gyy += gy * gy;
+                gxy += gx * gy;
+            }
+            float t = gxx - gyy;
+            float g2 = gxy + gxy;
+            float d = std::sqrt(t * t + g2 * g2);
+            // the larger of the two forms of the eigenvector is taken, since
+            // the other one vanishes when the tensor is almost diagonal.
+            if (t >= 0.0f) {
+                calc_direction(t + d, g2, dirp + x);
+            } else {
+                calc_direction(g2, d - t, dirp + x);
+            }
+            float magnitude = std::sqrt(0.5f * (gxx + gyy + d)) * scale;
+            dstp[x] = std::min(magnitude, maxval);
+        }
+        dstp[width - 1] = 0;
+        dirp[width - 1] = 0;
+        dstp += dpitch;
+        dirp += dirpitch;
+    }
+    memset(dstp, 0, dpitch * sizeof(float));
+    memset(dirp, 0, dirpitch * sizeof(int32_t));
 }
 
 
@@ -164,9 +226,11 @@ static void write_directions(const int32_t* dirp, int drpitch, void* dstp,
 }
 
 
+template <bool HIST>
 static void
 nms(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
-    float* dstp, int dpitch, const int width, const int height)
+    float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist)
 {
     memset(dstp, 0, dpitch * sizeof(float));
 
@@ -192,6 +256,12 @@ nms(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
                     v = 0;
             }
             dstp[x] = v;
+            if constexpr (HIST) {
+                if (v > 0) {
+                    auto bin = std::min(v * binscale, NMS_HIST_BINS - 1.0f);
+                    ++hist[static_cast<int>(bin)];
+                }
+            }
         }
         dstp[width - 1] = 0;
     }
@@ -199,230 +269,106 @@ nms(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
 }
 
 
+static void
+nms_c(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height)
+{
+    nms<false>(emaskp, epitch, dirp, dirpitch, dstp, dpitch, width, height,
+        0.0f, nullptr);
+}
+
+
+// emask kernels never read beyond the row if it has at least one block,
+// so any plane wider than that can be read without copying.
+bool emask_reads_in_place(arch_t arch, int width)
+{
+    switch (arch) {
+    case arch_t::NO_SIMD:
+        return true;
+    case arch_t::USE_SSE4:
+        return width >= 8 + 2;
+    case arch_t::USE_AVX2:
+        return width >= 16 + 2;
+    default:
+        return width >= 64 + 2;
+    }
+}
+
 
-edgemask_t get_emask(int bytes, arch_t arch, int mode)
+template <typename Td, bool SCALE, int OPERATOR, bool _STRICT, bool CALC_DIR,
+    bool NT>
+struct emask_kernel {
+    static constexpr emask_func_t func =
+        emask<Td, SCALE, OPERATOR, _STRICT, CALC_DIR>;
+};
+
+static const emask_table_t emask_table_c = make_emask_table<emask_kernel>();
+
+
+template <typename T>
+static void
+tile_range(const void* srcp, int spitch, int width, int height, float* minp,
+    float* maxp)
 {
-    using std::format;
-    std::unordered_map<std::string, edgemask_t> func;
-
-                                //arch, bytes, SCALE, OPERATOR, _STRICT, CALC_DIR
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, true,  0, true,  false)] = emask<uint8_t, true,  0, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, true,  0, false, false)] = emask<uint8_t, true,  0, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, true,  1, true,  false)] = emask<uint8_t, true,  1, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, true,  1, false, false)] = emask<uint8_t, true,  1, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, true,  2, true,  false)] = emask<uint8_t, true,  2, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, true,  2, false, false)] = emask<uint8_t, true,  2, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, false, 0, true,  false)] = emask<uint8_t, false, 0, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, false, 0, false, false)] = emask<uint8_t, false, 0, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, false, 1, true,  false)] = emask<uint8_t, false, 1, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, false, 1, false, false)] = emask<uint8_t, false, 1, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, false, 2, true,  false)] = emask<uint8_t, false, 2, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 1, false, 2, false, false)] = emask<uint8_t, false, 2, false, false>;
-
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, true,  0, true,  false)] = emask<uint16_t, true,  0, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, true,  0, false, false)] = emask<uint16_t, true,  0, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, true,  1, true,  false)] = emask<uint16_t, true,  1, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, true,  1, false, false)] = emask<uint16_t, true,  1, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, true,  2, true,  false)] = emask<uint16_t, true,  2, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, true,  2, false, false)] = emask<uint16_t, true,  2, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, false, 0, true,  false)] = emask<uint16_t, false, 0, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, false, 0, false, false)] = emask<uint16_t, false, 0, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, false, 1, true,  false)] = emask<uint16_t, false, 1, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, false, 1, false, false)] = emask<uint16_t, false, 1, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, false, 2, true,  false)] = emask<uint16_t, false, 2, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 2, false, 2, false, false)] = emask<uint16_t, false, 2, false, false>;
-
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  0, true,  false)] = emask<float, true,  0, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  0, false, false)] = emask<float, true,  0, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  1, true,  false)] = emask<float, true,  1, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  1, false, false)] = emask<float, true,  1, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  2, true,  false)] = emask<float, true,  2, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  2, false, false)] = emask<float, true,  2, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 0, true,  false)] = emask<float, false, 0, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 0, false, false)] = emask<float, false, 0, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 1, true,  false)] = emask<float, false, 1, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 1, false, false)] = emask<float, false, 1, false, false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 2, true,  false)] = emask<float, false, 2, true,  false>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 2, false, false)] = emask<float, false, 2, false, false>;
-
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  0, true,  true)] = emask<float, true,  0, true,  true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  0, false, true)] = emask<float, true,  0, false, true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  1, true,  true)] = emask<float, true,  1, true,  true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  1, false, true)] = emask<float, true,  1, false, true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  2, true,  true)] = emask<float, true,  2, true,  true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, true,  2, false, true)] = emask<float, true,  2, false, true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 0, true,  true)] = emask<float, false, 0, true,  true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 0, false, true)] = emask<float, false, 0, false, true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 1, true,  true)] = emask<float, false, 1, true,  true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 1, false, true)] = emask<float, false, 1, false, true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 2, true,  true)] = emask<float, false, 2, true,  true>;
-    func[format("{}{}{}{}{}{}", a2s(NO_SIMD), 4, false, 2, false, true)] = emask<float, false, 2, false, true>;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, false, 0, true,  false)] = emask_sse4_u8_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, false, 0, false, false)] = emask_sse4_u8_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, false, 1, true,  false)] = emask_sse4_u8_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, false, 1, false, false)] = emask_sse4_u8_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, false, 2, true,  false)] = emask_sse4_u8_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, false, 2, false, false)] = emask_sse4_u8_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, true,  0, true,  false)] = emask_sse4_u8_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, true,  0, false, false)] = emask_sse4_u8_sc_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, true,  1, true,  false)] = emask_sse4_u8_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, true,  1, false, false)] = emask_sse4_u8_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, true,  2, true,  false)] = emask_sse4_u8_sc_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 1, true,  2, false, false)] = emask_sse4_u8_sc_custom_fast;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, false, 0, true,  false)] = emask_sse4_u16_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, false, 0, false, false)] = emask_sse4_u16_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, false, 1, true,  false)] = emask_sse4_u16_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, false, 1, false, false)] = emask_sse4_u16_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, false, 2, true,  false)] = emask_sse4_u16_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, false, 2, false, false)] = emask_sse4_u16_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, true,  0, true,  false)] = emask_sse4_u16_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, true,  0, false, false)] = emask_sse4_u16_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, true,  1, true,  false)] = emask_sse4_u16_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, true,  1, false, false)] = emask_sse4_u16_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, true,  2, true,  false)] = emask_sse4_u16_sc_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 2, true,  2, false, false)] = emask_sse4_u16_sc_custom_strict;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 0, true,  false)] = emask_sse4_flt_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 0, false, false)] = emask_sse4_flt_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 1, true,  false)] = emask_sse4_flt_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 1, false, false)] = emask_sse4_flt_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 2, true,  false)] = emask_sse4_flt_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 2, false, false)] = emask_sse4_flt_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  0, true,  false)] = emask_sse4_flt_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  0, false, false)] = emask_sse4_flt_sc_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  1, true,  false)] = emask_sse4_flt_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  1, false, false)] = emask_sse4_flt_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  2, true,  false)] = emask_sse4_flt_sc_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  2, false, false)] = emask_sse4_flt_sc_custom_fast;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 0, true,  true)] = emask_sse4_flt_ns_std_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 0, false, true)] = emask_sse4_flt_ns_std_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 1, true,  true)] = emask_sse4_flt_ns_sobel_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 1, false, true)] = emask_sse4_flt_ns_sobel_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 2, true,  true)] = emask_sse4_flt_ns_custom_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, false, 2, false, true)] = emask_sse4_flt_ns_custom_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  0, true,  true)] = emask_sse4_flt_sc_std_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  0, false, true)] = emask_sse4_flt_sc_std_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  1, true,  true)] = emask_sse4_flt_sc_sobel_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  1, false, true)] = emask_sse4_flt_sc_sobel_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  2, true,  true)] = emask_sse4_flt_sc_custom_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_SSE4), 4, true,  2, false, true)] = emask_sse4_flt_sc_custom_fast_dir;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, false, 0, true,  false)] = emask_avx2_u8_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, false, 0, false, false)] = emask_avx2_u8_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, false, 1, true,  false)] = emask_avx2_u8_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, false, 1, false, false)] = emask_avx2_u8_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, false, 2, true,  false)] = emask_avx2_u8_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, false, 2, false, false)] = emask_avx2_u8_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, true,  0, true,  false)] = emask_avx2_u8_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, true,  0, false, false)] = emask_avx2_u8_sc_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, true,  1, true,  false)] = emask_avx2_u8_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, true,  1, false, false)] = emask_avx2_u8_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, true,  2, true,  false)] = emask_avx2_u8_sc_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 1, true,  2, false, false)] = emask_avx2_u8_sc_custom_fast;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, false, 0, true,  false)] = emask_avx2_u16_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, false, 0, false, false)] = emask_avx2_u16_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, false, 1, true,  false)] = emask_avx2_u16_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, false, 1, false, false)] = emask_avx2_u16_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, false, 2, true,  false)] = emask_avx2_u16_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, false, 2, false, false)] = emask_avx2_u16_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, true,  0, true,  false)] = emask_avx2_u16_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, true,  0, false, false)] = emask_avx2_u16_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, true,  1, true,  false)] = emask_avx2_u16_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, true,  1, false, false)] = emask_avx2_u16_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, true,  2, true,  false)] = emask_avx2_u16_sc_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 2, true,  2, false, false)] = emask_avx2_u16_sc_custom_strict;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 0, true,  false)] = emask_avx2_flt_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 0, false, false)] = emask_avx2_flt_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 1, true,  false)] = emask_avx2_flt_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 1, false, false)] = emask_avx2_flt_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 2, true,  false)] = emask_avx2_flt_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 2, false, false)] = emask_avx2_flt_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  0, true,  false)] = emask_avx2_flt_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  0, false, false)] = emask_avx2_flt_sc_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  1, true,  false)] = emask_avx2_flt_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  1, false, false)] = emask_avx2_flt_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  2, true,  false)] = emask_avx2_flt_sc_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  2, false, false)] = emask_avx2_flt_sc_custom_fast;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 0, true,  true)] = emask_avx2_flt_ns_std_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 0, false, true)] = emask_avx2_flt_ns_std_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 1, true,  true)] = emask_avx2_flt_ns_sobel_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 1, false, true)] = emask_avx2_flt_ns_sobel_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 2, true,  true)] = emask_avx2_flt_ns_custom_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, false, 2, false, true)] = emask_avx2_flt_ns_custom_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  0, true,  true)] = emask_avx2_flt_sc_std_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  0, false, true)] = emask_avx2_flt_sc_std_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  1, true,  true)] = emask_avx2_flt_sc_sobel_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  1, false, true)] = emask_avx2_flt_sc_sobel_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  2, true,  true)] = emask_avx2_flt_sc_custom_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX2), 4, true,  2, false, true)] = emask_avx2_flt_sc_custom_fast_dir;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, false, 0, true,  false)] = emask_avx512_u8_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, false, 0, false, false)] = emask_avx512_u8_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, false, 1, true,  false)] = emask_avx512_u8_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, false, 1, false, false)] = emask_avx512_u8_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, false, 2, true,  false)] = emask_avx512_u8_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, false, 2, false, false)] = emask_avx512_u8_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, true,  0, true,  false)] = emask_avx512_u8_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, true,  0, false, false)] = emask_avx512_u8_sc_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, true,  1, true,  false)] = emask_avx512_u8_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, true,  1, false, false)] = emask_avx512_u8_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, true,  2, true,  false)] = emask_avx512_u8_sc_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 1, true,  2, false, false)] = emask_avx512_u8_sc_custom_fast;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, false, 0, true,  false)] = emask_avx512_u16_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, false, 0, false, false)] = emask_avx512_u16_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, false, 1, true,  false)] = emask_avx512_u16_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, false, 1, false, false)] = emask_avx512_u16_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, false, 2, true,  false)] = emask_avx512_u16_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, false, 2, false, false)] = emask_avx512_u16_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, true,  0, true,  false)] = emask_avx512_u16_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, true,  0, false, false)] = emask_avx512_u16_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, true,  1, true,  false)] = emask_avx512_u16_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, true,  1, false, false)] = emask_avx512_u16_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, true,  2, true,  false)] = emask_avx512_u16_sc_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 2, true,  2, false, false)] = emask_avx512_u16_sc_custom_strict;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 0, true,  false)] = emask_avx512_flt_ns_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 0, false, false)] = emask_avx512_flt_ns_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 1, true,  false)] = emask_avx512_flt_ns_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 1, false, false)] = emask_avx512_flt_ns_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 2, true,  false)] = emask_avx512_flt_ns_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 2, false, false)] = emask_avx512_flt_ns_custom_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  0, true,  false)] = emask_avx512_flt_sc_std_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  0, false, false)] = emask_avx512_flt_sc_std_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  1, true,  false)] = emask_avx512_flt_sc_sobel_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  1, false, false)] = emask_avx512_flt_sc_sobel_fast;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  2, true,  false)] = emask_avx512_flt_sc_custom_strict;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  2, false, false)] = emask_avx512_flt_sc_custom_fast;
-
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 0, true,  true)] = emask_avx512_flt_ns_std_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 0, false, true)] = emask_avx512_flt_ns_std_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 1, true,  true)] = emask_avx512_flt_ns_sobel_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 1, false, true)] = emask_avx512_flt_ns_sobel_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 2, true,  true)] = emask_avx512_flt_ns_custom_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, false, 2, false, true)] = emask_avx512_flt_ns_custom_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  0, true,  true)] = emask_avx512_flt_sc_std_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  0, false, true)] = emask_avx512_flt_sc_std_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  1, true,  true)] = emask_avx512_flt_sc_sobel_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  1, false, true)] = emask_avx512_flt_sc_sobel_fast_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  2, true,  true)] = emask_avx512_flt_sc_custom_strict_dir;
-    func[format("{}{}{}{}{}{}", a2s(USE_AVX512), 4, true,  2, false, true)] = emask_avx512_flt_sc_custom_fast_dir;
+    const T* s = reinterpret_cast<const T*>(srcp);
 
+    for (int x = 0; x < width; ++x) {
+        minp[x] = maxp[x] = s[x];
+    }
+    for (int y = 1; y < height; ++y) {
+        s += spitch;
+        for (int x = 0; x < width; ++x) {
+            minp[x] = std::min(minp[x], static_cast<float>(s[x]));
+            maxp[x] = std::max(maxp[x], static_cast<float>(s[x]));
+        }
+    }
+}
+
+static const tile_range_table_t tile_range_table_c = {
+    tile_range<uint8_t>, tile_range<uint16_t>, tile_range<float>,
+};
+
+
+edgemask_t get_emask(int bytes, arch_t arch, int mode)
+{
     bool scale = (mode & SCALE_MAGNITUDE);
     int opr = (mode & USE_STANDARD_OPERATOR) ? 0
         : (mode & USE_SOBEL_OPERATOR) ? 1 : 2;
     bool strict = (mode & STRICT_MAGNITUDE);
     bool dir = (mode & CALC_DIRECTION);
-    if (dir) bytes = 4;
+    int type = dir ? EMASK_FLT_DIR : bytes == 1 ? EMASK_U8
+        : bytes == 2 ? EMASK_U16 : EMASK_FLT;
 
-    auto key = format("{}{}{}{}{}{}", a2s(arch), bytes, scale, opr, strict, dir);
-    return func.at(key);
+    const emask_table_t* table;
+    switch (arch) {
+    case arch_t::NO_SIMD:
+        table = &emask_table_c;
+        break;
+    case arch_t::USE_SSE4:
+        table = &emask_table_sse4;
+        break;
+    case arch_t::USE_AVX2:
+        table = &emask_table_avx2;
+        break;
+    default:
+        table = (mode & STREAM_OUTPUT) ? &emask_table_avx512_nt
+            : &emask_table_avx512;
+    }
+    return (*table)[type][scale][opr][strict];
+}
+
+
+color_emask_t get_color_emask(arch_t arch)
+{
+    switch (arch) {
+    case arch_t::NO_SIMD:
+        return color_emask;
+    case arch_t::USE_SSE4:
+        return color_emask_sse4;
+    default:
+        // AVX512 uses the AVX2 kernel.
+        return color_emask_avx2;
+    }
 }
 
 
@@ -443,7 +389,7 @@ nms_t get_nms(arch_t arch)
 {
     switch (arch) {
     case arch_t::NO_SIMD:
-        return nms;
+        return nms_c;
     case arch_t::USE_SSE4:
         return nms_sse4;
     case arch_t::USE_AVX2:
@@ -452,3 +398,34 @@ nms_t get_nms(arch_t arch)
         return nms_avx512;
     }
 }
+
+
+nms_hist_t get_nms_hist(arch_t arch)
+{
+    switch (arch) {
+    case arch_t::NO_SIMD:
+        return nms<true>;
+    case arch_t::USE_SSE4:
+        return nms_hist_sse4;
+    case arch_t::USE_AVX2:
+        return nms_hist_avx2;
+    default:
+        return nms_hist_avx512;
+    }
+}
+
+
+tile_range_t get_tile_range(int bytes, arch_t arch)
+{
+    int type = bytes == 1 ? 0 : bytes == 2 ? 1 : 2;
+    switch (arch) {
+    case arch_t::NO_SIMD:
+        return tile_range_table_c[type];
+    case arch_t::USE_SSE4:
+        return tile_range_table_sse4[type];
+    case arch_t::USE_AVX2:
+        return tile_range_table_avx2[type];
+    default:
+        return tile_range_table_avx512[type];
+    }
+}
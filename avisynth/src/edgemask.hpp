@@ -25,591 +25,115 @@
 #ifndef EDGEMASK_HPP
 #define EDGEMASK_HPP
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
 
-void emask_sse4_u8_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+// histogram of non-suppressed magnitudes accumulated by nms_hist_*.
+// it has NMS_HIST_LANES sub-histograms to avoid dependencies between lanes.
+constexpr int NMS_HIST_BINS = 1024;
+constexpr int NMS_HIST_LANES = 8;
 
-void emask_sse4_u8_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
 
-void emask_sse4_u8_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+using emask_func_t = void(*)(const float* blurp, int blpitch, void* dstp,
+    int dpitch, std::array<float, 3>& opr, float scale, int width, int height,
+    float maxval, int32_t* dirp, int dirpitch);
 
-void emask_sse4_u8_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+enum emask_type_t {
+    EMASK_U8,
+    EMASK_U16,
+    EMASK_FLT,
+    EMASK_FLT_DIR,   // float magnitude and directions
+    NUM_EMASK_TYPES,
+};
 
-void emask_sse4_u8_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+using emask_set_t = std::array<std::array<std::array<emask_func_t, 2>, 3>, 2>;
 
-void emask_sse4_u8_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+// edge mask kernels of an arch, indexed by
+// [emask_type_t][SCALE][OPERATOR][_STRICT].
+using emask_table_t = std::array<emask_set_t, NUM_EMASK_TYPES>;
 
-void emask_sse4_u8_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
 
-void emask_sse4_u8_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+template <template <typename, bool, int, bool, bool, bool> class K,
+    typename Td, bool CALC_DIR, bool NT, size_t... I>
+constexpr emask_set_t make_emask_set(std::index_sequence<I...>)
+{
+    emask_set_t set{};
+    ((set[I / 6][I / 2 % 3][I % 2] =
+        K<Td, (I / 6 != 0), I / 2 % 3, (I % 2 != 0), CALC_DIR, NT>::func), ...);
+    return set;
+}
 
-void emask_sse4_u8_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+// K<Td, SCALE, OPERATOR, _STRICT, CALC_DIR, NT>::func is the kernel.
+// every entry is placed by the template arguments of its kernel, so that
+// the table cannot be mis-wired.
+template <template <typename, bool, int, bool, bool, bool> class K,
+    bool NT = false>
+constexpr emask_table_t make_emask_table()
+{
+    constexpr auto seq = std::make_index_sequence<2 * 3 * 2>();
+    return {
+        make_emask_set<K, uint8_t, false, NT>(seq),
+        make_emask_set<K, uint16_t, false, NT>(seq),
+        make_emask_set<K, float, false, NT>(seq),
+        make_emask_set<K, float, true, NT>(seq),
+    };
+}
 
-void emask_sse4_u8_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
 
-void emask_sse4_u8_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+extern const emask_table_t emask_table_sse4;
 
-void emask_sse4_u8_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+extern const emask_table_t emask_table_avx2;
 
-void emask_sse4_u16_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+extern const emask_table_t emask_table_avx512;
 
-void emask_sse4_u16_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+// non-temporal variants, for output planes that are not read again.
+extern const emask_table_t emask_table_avx512_nt;
 
-void emask_sse4_u16_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
 
-void emask_sse4_u16_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_u16_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_u16_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_u16_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_u16_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_u16_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_u16_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_u16_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_u16_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_ns_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_sse4_flt_sc_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u8_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_u16_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_ns_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx2_flt_sc_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u8_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_u16_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_ns_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
-
-void emask_avx512_flt_sc_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+void nms_sse4(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height);
 
-void emask_avx512_flt_ns_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+void nms_avx2(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height);
 
-void emask_avx512_flt_sc_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+void nms_avx512(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height);
 
-void emask_avx512_flt_ns_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+void nms_hist_sse4(float* emaskp, const int epitch, const int32_t* dirp,
+    int dirpitch, float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist);
 
-void emask_avx512_flt_sc_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+void nms_hist_avx2(float* emaskp, const int epitch, const int32_t* dirp,
+    int dirpitch, float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist);
 
-void emask_avx512_flt_ns_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+void nms_hist_avx512(float* emaskp, const int epitch, const int32_t* dirp,
+    int dirpitch, float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist);
 
-void emask_avx512_flt_sc_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
 
-void emask_avx512_flt_ns_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+// joint gradient of three planes, see color_emask in edgemask.cpp.
+void color_emask_sse4(const float* const* blurp, int blpitch, float* dstp,
+    int dpitch, std::array<float, 3>& opr, float scale, int width, int height,
+    float maxval, int32_t* dirp, int dirpitch);
 
-void emask_avx512_flt_sc_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+void color_emask_avx2(const float* const* blurp, int blpitch, float* dstp,
+    int dpitch, std::array<float, 3>& opr, float scale, int width, int height,
+    float maxval, int32_t* dirp, int dirpitch);
 
-void emask_avx512_flt_ns_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
 
-void emask_avx512_flt_sc_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch);
+using tile_range_func_t = void(*)(const void* srcp, int spitch, int width,
+    int height, float* minp, float* maxp);
 
+// tile_range kernels of an arch, indexed by 8bit, 16bit and float.
+using tile_range_table_t = std::array<tile_range_func_t, 3>;
 
-void nms_sse4(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
-    float* dstp, int dpitch, const int width, const int height);
+extern const tile_range_table_t tile_range_table_sse4;
 
-void nms_avx2(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
-    float* dstp, int dpitch, const int width, const int height);
+extern const tile_range_table_t tile_range_table_avx2;
 
-void nms_avx512(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
-    float* dstp, int dpitch, const int width, const int height);
+extern const tile_range_table_t tile_range_table_avx512;
 
 #endif //  EDGEMASK_HPP
\ No newline at end of file
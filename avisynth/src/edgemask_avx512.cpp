@@ -22,6 +22,7 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
 */
 
+#include <algorithm>
 #include <array>
 #include "edgemask.hpp"
 #include "simd.hpp"
@@ -59,7 +60,7 @@ calc_direction(const __m512& gx0, const __m512& gx1, const __m512& gx2,
     angle0 = _or(angle0, _mm512_mask_blend_epi32(t, z, a135deg));
 
     tangent = fdiv(gy1, gx1);
-    t = _mm512_cmp_ps_mask(tangent, t78p, _CMP_NLT_UQ) & _mm512_cmp_ps_mask(tangent, t18p, _CMP_NGE_UQ);
+    t = _mm512_cmp_ps_mask(tangent, t78p, _CMP_GE_OQ) & _mm512_cmp_ps_mask(tangent, t18p, _CMP_LT_OQ);
     __m512i angle1 = _mm512_mask_blend_epi32(t, z, a000deg);
     t = _mm512_cmp_ps_mask(tangent, t18p, _CMP_GE_OQ) & _mm512_cmp_ps_mask(tangent, t38p, _CMP_LT_OQ);
     angle1 = _or(angle1, _mm512_mask_blend_epi32(t, z, a045deg));
@@ -79,7 +80,7 @@ calc_direction(const __m512& gx0, const __m512& gx1, const __m512& gx2,
     angle2 = _or(angle2, _mm512_mask_blend_epi32(t, z, a135deg));
 
     tangent = fdiv(gy3, gx3);
-    t = _mm512_cmp_ps_mask(tangent, t78p, _CMP_GE_OQ) | _mm512_cmp_ps_mask(tangent, t18p, _CMP_LT_OQ);
+    t = _mm512_cmp_ps_mask(tangent, t78p, _CMP_GE_OQ) & _mm512_cmp_ps_mask(tangent, t18p, _CMP_LT_OQ);
     __m512i angle3 = _mm512_mask_blend_epi32(t, z, a000deg);
     t = _mm512_cmp_ps_mask(tangent, t18p, _CMP_GE_OQ) & _mm512_cmp_ps_mask(tangent, t38p, _CMP_LT_OQ);
     angle3 = _or(angle3, _mm512_mask_blend_epi32(t, z, a045deg));
@@ -95,7 +96,8 @@ calc_direction(const __m512& gx0, const __m512& gx1, const __m512& gx2,
 }
 
 
-template <typename Td, bool SCALE, int OPERATOR, bool _STRICT, bool CALC_DIR>
+template <typename Td, bool SCALE, int OPERATOR, bool _STRICT, bool CALC_DIR,
+    bool NT = false>
 SFINLINE void
 emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
     float scale, int width, int height, float maxval, int32_t* dirp,
@@ -104,13 +106,24 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
     Td* d = reinterpret_cast<Td*>(dstp);
     int step = sizeof(__m512) / sizeof(float);
 
+    // the last block of each row is moved back so as not to read beyond the
+    // row, unless the row is narrower than a block.
+    const int last = width - 1 - step * 4;
+
+    // with NT, each row is built in a buffer that stays in cache, and then
+    // streamed to the destination. so is a row narrower than a block, whose
+    // block would be written beyond the pitch.
+    const bool narrow = last <= 0;
+    LocalBuffer<Td> row(NT || narrow ? width + 64 : 0);
+    LocalBuffer<int32_t> dirrow(CALC_DIR && narrow ? width + 64 : 0);
+
     const __m512 p0 = set1_ps<__m512>(opr[0]);
     const __m512 p1 = set1_ps<__m512>(opr[1]);
     const __m512 p2 = set1_ps<__m512>(opr[2]);
     const __m512 sc = set1_ps<__m512>(scale);
     const __m512 maxv = set1_ps<__m512>(maxval);
 
-    memset(d, 0, width + sizeof(Td));
+    memset(d, 0, width * sizeof(Td));
     d += dpitch;
 
     if constexpr (CALC_DIR) {
@@ -122,12 +135,17 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
         const float* above = blurp;             // above      a[x-1] a[x] a[x+1]
         const float* centr = blurp + blpitch;   // center     c[x-1] c[x] c[x+1]
         const float* below = centr + blpitch;   // bellow     b[x-1] b[x] b[x+1]
-        d[0] = 0;
+        Td* o = NT || narrow ? row.data() : d;
+        int32_t* dr = narrow ? dirrow.data() : dirp;
+        o[0] = 0;
         if constexpr (CALC_DIR) {
-            dirp[0] = 0;
+            dr[0] = 0;
         }
 
         for (int x = 1; x < width - 1; x += step * 4) {
+            if (x > last && last > 0) {
+                x = last;
+            }
             __m512 gx0, gx1, gx2, gx3, gy0, gy1, gy2, gy3;
             int L0 = x - 1, L1 = x - 1 + step, L2 = x - 1 + step * 2, L3 = x - 1 + step * 3,
                 R0 = x + 1, R1 = x + 1 + step, R2 = x + 1 + step * 2, R3 = x + 1 + step * 3,
@@ -149,7 +167,7 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
                 __m512 t0 = loadu<__m512>(above + L0);
                 gx0 = fsub(gx0, t0);
                 gy0 = fadd(gy0, t0);
-                t0 = load<__m512>(below + R0);
+                t0 = loadu<__m512>(below + R0);
                 gx0 = fadd(gx0, t0);
                 gy0 = fsub(gy0, t0);
                 t0 = loadu<__m512>(centr + R0);
@@ -167,7 +185,7 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
                 t0 = loadu<__m512>(above + L1);
                 gx1 = fsub(gx1, t0);
                 gy1 = fadd(gy1, t0);
-                t0 = load<__m512>(below + R1);
+                t0 = loadu<__m512>(below + R1);
                 gx1 = fadd(gx1, t0);
                 gy1 = fsub(gy1, t0);
                 t0 = loadu<__m512>(centr + R1);
@@ -185,7 +203,7 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
                 t0 = loadu<__m512>(above + L2);
                 gx2 = fsub(gx2, t0);
                 gy2 = fadd(gy2, t0);
-                t0 = load<__m512>(below + R2);
+                t0 = loadu<__m512>(below + R2);
                 gx2 = fadd(gx2, t0);
                 gy2 = fsub(gy2, t0);
                 t0 = loadu<__m512>(centr + R2);
@@ -203,7 +221,7 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
                 t0 = loadu<__m512>(above + L3);
                 gx3 = fsub(gx3, t0);
                 gy3 = fadd(gy3, t0);
-                t0 = load<__m512>(below + R3);
+                t0 = loadu<__m512>(below + R3);
                 gx3 = fadd(gx3, t0);
                 gy3 = fsub(gy3, t0);
                 t0 = loadu<__m512>(centr + R3);
@@ -277,7 +295,7 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
                 gy3 = fnmadd(loadu<__m512>(below + C3), p1, gy3);
             }
             if constexpr (CALC_DIR) {
-                calc_direction(gx0, gx1, gx2, gx3, gy0, gy1, gy2, gy3, dirp + x);
+                calc_direction(gx0, gx1, gx2, gx3, gy0, gy1, gy2, gy3, dr + x);
             }
             __m512 mag0, mag1, mag2, mag3;
             if constexpr (_STRICT) {
@@ -302,38 +320,57 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
             mag2 = fmin<__m512>(mag2, maxv);
             mag3 = fmin<__m512>(mag3, maxv);
             if constexpr (is_same_v<Td, float>) {
-                storeu<__m512>(d + x, mag0);
-                storeu<__m512>(d + C1, mag1);
-                storeu<__m512>(d + C2, mag2);
-                storeu<__m512>(d + C3, mag3);
+                storeu<__m512>(o + x, mag0);
+                storeu<__m512>(o + C1, mag1);
+                storeu<__m512>(o + C2, mag2);
+                storeu<__m512>(o + C3, mag3);
             }
             else if constexpr (is_same_v<Td, uint16_t>) {
                 __m512i m0 = cvtps_epu16<__m512i, __m512>(mag0, mag1);
                 __m512i m1 = cvtps_epu16<__m512i, __m512>(mag2, mag3);
-                storeu<__m512i>(d + x, m0);
-                storeu<__m512i>(d + C2, m1);
+                storeu<__m512i>(o + x, m0);
+                storeu<__m512i>(o + C2, m1);
             }
             else if constexpr (is_same_v<Td, uint8_t>) {
                 __m512i m0 = cvtps_epu8_2(mag0, mag1, mag2, mag3);
-                storeu<__m512i>(d + x, m0);
+                storeu<__m512i>(o + x, m0);
             }
         }
-        d[width - 1] = 0;
+        o[width - 1] = 0;
+        if constexpr (NT) {
+            stream_row<__m512i>(d, o, width * sizeof(Td));
+        } else if (narrow) {
+            memcpy(d, o, width * sizeof(Td));
+        }
         blurp += blpitch;
         d += dpitch;
         if constexpr (CALC_DIR) {
-            dirp[width - 1] = 0;
+            dr[width - 1] = 0;
+            if (narrow) {
+                memcpy(dirp, dr, width * sizeof(int32_t));
+            }
             dirp += dirpitch;
         }
     }
     memset(d, 0, width * sizeof(Td));
+    if constexpr (CALC_DIR) {
+        memset(dirp, 0, dirpitch * sizeof(int32_t));
+    }
+    if constexpr (NT) {
+        _mm_sfence();
+    }
 }
 
 
-void nms_avx512(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
-    float* dstp, int dpitch, const int width, const int height)
+template <bool HIST>
+SFINLINE void
+nms(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist)
 {
     int step = sizeof(__m512) / sizeof(float);
+    const __m512 bs = set1_ps<__m512>(binscale);
+    const __m512 maxbin = set1_ps<__m512>(NMS_HIST_BINS - 1);
 
     const __m512i a000deg = _mm512_set1_epi32(15);
     const __m512i a045deg = _mm512_set1_epi32(31);
@@ -374,6 +411,23 @@ void nms_avx512(float* emaskp, const int epitch, const int32_t* dirp, int dirpit
             mask = _mm512_cmp_ps_mask(edge, p0, _CMP_LT_OQ);
             edge = _mm512_mask_blend_ps(mask, edge, zero);
             storeu<__m512>(dstp + x, edge);
+
+            if constexpr (HIST) {
+                // lanes past the right edge are not counted.
+                alignas(64) int32_t bin[sizeof(__m512) / sizeof(float)];
+                __m512i b = _mm512_cvttps_epi32(
+                    fmin<__m512>(fmul(edge, bs), maxbin));
+                store<__m512i>(bin, b);
+                int m = _mm512_cmp_ps_mask(edge, zero, _CMP_GT_OQ);
+                if (width - 1 - x < step) {
+                    m &= (1 << (width - 1 - x)) - 1;
+                }
+                for (int i = 0; i < step; ++i) {
+                    if (m & (1 << i)) {
+                        ++hist[(i % NMS_HIST_LANES) * NMS_HIST_BINS + bin[i]];
+                    }
+                }
+            }
         }
         dstp[width - 1] = 0;
     }
@@ -381,386 +435,80 @@ void nms_avx512(float* emaskp, const int epitch, const int32_t* dirp, int dirpit
 }
 
 
-void emask_avx512_u8_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u8_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_u16_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
+void nms_avx512(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height)
 {
-    emask<float, false, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
+    nms<false>(emaskp, epitch, dirp, dirpitch, dstp, dpitch, width, height,
+        0.0f, nullptr);
 }
 
-void emask_avx512_flt_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
 
-void emask_avx512_flt_ns_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
+void nms_hist_avx512(float* emaskp, const int epitch, const int32_t* dirp,
+    int dirpitch, float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist)
 {
-    emask<float, false, 0, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
+    nms<true>(emaskp, epitch, dirp, dirpitch, dstp, dpitch, width, height,
+        binscale, hist);
 }
 
-void emask_avx512_flt_sc_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 0, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
 
-void emask_avx512_flt_ns_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 1, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_sc_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
+// min and max of each column over the rows, from which
+// TCannyCore::findActiveTiles builds the range of each tile.
+template <typename T>
+static void
+tile_range(const void* srcp, int spitch, int width, int height, float* minp,
+    float* maxp)
 {
-    emask<float, true, 1, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+    using V = std::conditional_t<std::is_same_v<T, float>, __m512, __m512i>;
+    constexpr int step = sizeof(V) / sizeof(T);
+    const T* s = reinterpret_cast<const T*>(srcp);
 
-void emask_avx512_flt_ns_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 2, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_avx512_flt_sc_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 2, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
+    int x = 0;
+    for (; x + step <= width; x += step) {
+        V lo = loadu<V>(s + x);
+        V hi = lo;
+        for (int y = 1; y < height; ++y) {
+            V v = loadu<V>(s + x + static_cast<size_t>(y) * spitch);
+            lo = min_as<T>(lo, v);
+            hi = max_as<T>(hi, v);
+        }
+        alignas(64) T l[step], h[step];
+        store<V>(l, lo);
+        store<V>(h, hi);
+        for (int i = 0; i < step; ++i) {
+            minp[x + i] = l[i];
+            maxp[x + i] = h[i];
+        }
+    }
+    for (; x < width; ++x) {
+        T lo = s[x], hi = s[x];
+        for (int y = 1; y < height; ++y) {
+            T v = s[x + static_cast<size_t>(y) * spitch];
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        }
+        minp[x] = lo;
+        maxp[x] = hi;
+    }
 }
 
-void emask_avx512_flt_ns_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 0, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+const tile_range_table_t tile_range_table_avx512 = {
+    tile_range<uint8_t>, tile_range<uint16_t>, tile_range<float>,
+};
 
-void emask_avx512_flt_sc_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 0, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
 
-void emask_avx512_flt_ns_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 1, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+template <typename Td, bool SCALE, int OPERATOR, bool _STRICT, bool CALC_DIR,
+    bool NT>
+struct emask_kernel {
+    // non-temporal stores are used only where they measured faster:
+    // 16bit output without directions. float was 1% slower streamed.
+    static constexpr bool STREAM = NT && sizeof(Td) == 2 && !CALC_DIR;
 
-void emask_avx512_flt_sc_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 1, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+    static constexpr emask_func_t func =
+        emask<Td, SCALE, OPERATOR, _STRICT, CALC_DIR, STREAM>;
+};
 
-void emask_avx512_flt_ns_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 2, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+const emask_table_t emask_table_avx512 = make_emask_table<emask_kernel>();
 
-void emask_avx512_flt_sc_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 2, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+const emask_table_t emask_table_avx512_nt =
+    make_emask_table<emask_kernel, true>();
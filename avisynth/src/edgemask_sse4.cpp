@@ -23,6 +23,7 @@
 */
 
 
+#include <algorithm>
 #include <array>
 #include "edgemask.hpp"
 #include "simd.hpp"
@@ -95,6 +96,10 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
         dirp += dirpitch;
     }
 
+    // the last block of each row is moved back so as not to read beyond the
+    // row, unless the row is narrower than a block.
+    const int last = width - 1 - step * 2;
+
     for (int y = 1; y < height - 1; ++y) {
         const float* above = blurp;             // above      a[x-1] a[x] a[x+1]
         const float* centr = blurp + blpitch;   // center     c[x-1] c[x] c[x+1]
@@ -105,6 +110,9 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
         }
 
         for (int x = 1; x < width - 1; x += step * 2) {
+            if (x > last && last > 0) {
+                x = last;
+            }
             __m128 gx0, gx1, gy0, gy1;
             int L = x - 1, R = x + 1;
             if constexpr (OPERATOR == 0) { // standard
@@ -122,7 +130,7 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
                 __m128 t0 = loadu<__m128>(above + L);
                 gx0 = fsub(gx0, t0);
                 gy0 = fadd(gy0, t0);
-                t0 = load<__m128>(below + R);
+                t0 = loadu<__m128>(below + R);
                 gx0 = fadd(gx0, t0);
                 gy0 = fsub(gy0, t0);
                 t0 = loadu<__m128>(centr + R);
@@ -140,7 +148,7 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
                 t0 = loadu<__m128>(above + L + step);
                 gx1 = fsub(gx1, t0);
                 gy1 = fadd(gy1, t0);
-                t0 = load<__m128>(below + R + step);
+                t0 = loadu<__m128>(below + R + step);
                 gx1 = fadd(gx1, t0);
                 gy1 = fsub(gy1, t0);
                 t0 = loadu<__m128>(centr + R + step);
@@ -222,13 +230,21 @@ emask(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float,
         }
     }
     memset(d, 0, width * sizeof(Td));
+    if constexpr (CALC_DIR) {
+        memset(dirp, 0, dirpitch * sizeof(int32_t));
+    }
 }
 
 
-void nms_sse4(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
-    float* dstp, int dpitch, const int width, const int height)
+template <bool HIST>
+SFINLINE void
+nms(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist)
 {
     int step = sizeof(__m128) / sizeof(float);
+    const __m128 bs = set1_ps<__m128>(binscale);
+    const __m128 maxbin = set1_ps<__m128>(NMS_HIST_BINS - 1);
 
     memset(dstp, 0, dpitch * sizeof(float));
 
@@ -273,6 +289,22 @@ void nms_sse4(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch
             mask = cmplt_ps<__m128, __m128>(edge, p0);
             edge = blendv(edge, zero<__m128>(), mask);
             storeu<__m128>(dstp + x, edge);
+
+            if constexpr (HIST) {
+                // lanes past the right edge are not counted.
+                alignas(16) int32_t bin[sizeof(__m128) / sizeof(float)];
+                __m128i b = _mm_cvttps_epi32(fmin(fmul(edge, bs), maxbin));
+                store<__m128i>(bin, b);
+                int m = _mm_movemask_ps(_mm_cmpgt_ps(edge, zero<__m128>()));
+                if (width - 1 - x < step) {
+                    m &= (1 << (width - 1 - x)) - 1;
+                }
+                for (int i = 0; i < step; ++i) {
+                    if (m & (1 << i)) {
+                        ++hist[(i % NMS_HIST_LANES) * NMS_HIST_BINS + bin[i]];
+                    }
+                }
+            }
         }
         dstp[width - 1] = 0;
     }
@@ -280,387 +312,163 @@ void nms_sse4(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch
 }
 
 
-void emask_sse4_u8_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, false, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u8_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint8_t, true, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, false, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_u16_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<uint16_t, true, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_ns_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_sc_std_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 0, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_ns_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_sc_sobel_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 1, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_ns_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_sc_custom_fast(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 2, false, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_ns_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_sc_std_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 0, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_ns_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
-
-void emask_sse4_flt_sc_sobel_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
+void nms_sse4(float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height)
 {
-    emask<float, true, 1, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
+    nms<false>(emaskp, epitch, dirp, dirpitch, dstp, dpitch, width, height,
+        0.0f, nullptr);
 }
 
-void emask_sse4_flt_ns_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
 
-void emask_sse4_flt_sc_custom_strict(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
+void nms_hist_sse4(float* emaskp, const int epitch, const int32_t* dirp,
+    int dirpitch, float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist)
 {
-    emask<float, true, 2, true, false>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
+    nms<true>(emaskp, epitch, dirp, dirpitch, dstp, dpitch, width, height,
+        binscale, hist);
 }
 
-void emask_sse4_flt_ns_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 0, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
 
-void emask_sse4_flt_sc_std_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 0, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
+// joint gradient of the three planes at x, see color_emask in edgemask.cpp.
+SFINLINE void
+joint_gradient(const float* const* rows, int blpitch, int x, const __m128& p0,
+    const __m128& p1, const __m128& p2, __m128& vx, __m128& vy, __m128& mag)
+{
+    __m128 gxx = zero<__m128>(), gyy = zero<__m128>(), gxy = zero<__m128>();
+    int L = x - 1, R = x + 1;
+    for (int p = 0; p < 3; ++p) {
+        const float* above = rows[p];
+        const float* centr = above + blpitch;
+        const float* below = centr + blpitch;
+        __m128 t0 = fmul(loadu<__m128>(below + R), p2);
+        __m128 t1 = fmul(loadu<__m128>(above + L), p0);
+        __m128 gx = fsub(t0, t1);
+        __m128 gy = fsub(t1, t0);
+        t0 = loadu<__m128>(above + R);
+        gx = fmadd(t0, p0, gx);
+        gy = fmadd(t0, p2, gy);
+        t0 = loadu<__m128>(below + L);
+        gx = fnmadd(t0, p2, gx);
+        gy = fnmadd(t0, p0, gy);
+        gx = fmadd(loadu<__m128>(centr + R), p1, gx);
+        gx = fnmadd(loadu<__m128>(centr + L), p1, gx);
+        gy = fmadd(loadu<__m128>(above + x), p1, gy);
+        gy = fnmadd(loadu<__m128>(below + x), p1, gy);
+        gxx = fmadd(gx, gx, gxx);
+        gyy = fmadd(gy, gy, gyy);
+        gxy = fmadd(gx, gy, gxy);
+    }
+    __m128 t = fsub(gxx, gyy);
+    __m128 g2 = fadd(gxy, gxy);
+    __m128 d = fsqrt(fmadd(g2, g2, fmul(t, t)));
+    __m128 neg = cmplt_ps<__m128, __m128>(t, zero<__m128>());
+    vx = blendv(fadd(t, d), g2, neg);
+    vy = blendv(g2, fsub(d, t), neg);
+    mag = fsqrt(fmul(fadd(fadd(gxx, gyy), d), set1_ps<__m128>(0.5f)));
 }
 
-void emask_sse4_flt_ns_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 1, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
 
-void emask_sse4_flt_sc_sobel_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
+void color_emask_sse4(const float* const* blurp, int blpitch, float* dstp,
+    int dpitch, std::array<float, 3>& opr, float scale, int width, int height,
+    float maxval, int32_t* dirp, int dirpitch)
 {
-    emask<float, true, 1, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+    int step = sizeof(__m128) / sizeof(float);
 
-void emask_sse4_flt_ns_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 2, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+    const __m128 p0 = set1_ps<__m128>(opr[0]);
+    const __m128 p1 = set1_ps<__m128>(opr[1]);
+    const __m128 p2 = set1_ps<__m128>(opr[2]);
+    const __m128 sc = set1_ps<__m128>(scale);
+    const __m128 maxv = set1_ps<__m128>(maxval);
 
-void emask_sse4_flt_sc_custom_fast_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 2, false, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+    memset(dstp, 0, width * sizeof(float));
+    memset(dirp, 0, dirpitch * sizeof(int32_t));
+    dstp += dpitch;
+    dirp += dirpitch;
 
-void emask_sse4_flt_ns_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 0, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+    // the last block of each row is moved back as in emask.
+    const int last = width - 1 - step * 2;
 
-void emask_sse4_flt_sc_std_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 0, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+    for (int y = 1; y < height - 1; ++y) {
+        size_t offset = static_cast<size_t>(y - 1) * blpitch;
+        const float* rows[] = {
+            blurp[0] + offset, blurp[1] + offset, blurp[2] + offset,
+        };
+        dstp[0] = 0;
+        dirp[0] = 0;
 
-void emask_sse4_flt_ns_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 1, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
+        for (int x = 1; x < width - 1; x += step * 2) {
+            if (x > last && last > 0) {
+                x = last;
+            }
+            __m128 vx0, vx1, vy0, vy1, mag0, mag1;
+            joint_gradient(rows, blpitch, x, p0, p1, p2, vx0, vy0, mag0);
+            joint_gradient(rows, blpitch, x + step, p0, p1, p2, vx1, vy1, mag1);
+            calc_direction(vx0, vx1, vy0, vy1, dirp + x);
+            mag0 = fmin(fmul(mag0, sc), maxv);
+            mag1 = fmin(fmul(mag1, sc), maxv);
+            storeu<__m128>(dstp + x, mag0);
+            storeu<__m128>(dstp + x + step, mag1);
+        }
+        dstp[width - 1] = 0;
+        dirp[width - 1] = 0;
+        dstp += dpitch;
+        dirp += dirpitch;
+    }
+    memset(dstp, 0, width * sizeof(float));
+    memset(dirp, 0, dirpitch * sizeof(int32_t));
+}
+
+
+// min and max of each column over the rows, from which
+// TCannyCore::findActiveTiles builds the range of each tile.
+template <typename T>
+static void
+tile_range(const void* srcp, int spitch, int width, int height, float* minp,
+    float* maxp)
+{
+    using V = std::conditional_t<std::is_same_v<T, float>, __m128, __m128i>;
+    constexpr int step = sizeof(V) / sizeof(T);
+    const T* s = reinterpret_cast<const T*>(srcp);
+
+    int x = 0;
+    for (; x + step <= width; x += step) {
+        V lo = loadu<V>(s + x);
+        V hi = lo;
+        for (int y = 1; y < height; ++y) {
+            V v = loadu<V>(s + x + static_cast<size_t>(y) * spitch);
+            lo = min_as<T>(lo, v);
+            hi = max_as<T>(hi, v);
+        }
+        alignas(16) T l[step], h[step];
+        store<V>(l, lo);
+        store<V>(h, hi);
+        for (int i = 0; i < step; ++i) {
+            minp[x + i] = l[i];
+            maxp[x + i] = h[i];
+        }
+    }
+    for (; x < width; ++x) {
+        T lo = s[x], hi = s[x];
+        for (int y = 1; y < height; ++y) {
+            T v = s[x + static_cast<size_t>(y) * spitch];
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        }
+        minp[x] = lo;
+        maxp[x] = hi;
+    }
 }
 
-void emask_sse4_flt_sc_sobel_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 1, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+const tile_range_table_t tile_range_table_sse4 = {
+    tile_range<uint8_t>, tile_range<uint16_t>, tile_range<float>,
+};
 
-void emask_sse4_flt_ns_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, false, 2, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
 
-void emask_sse4_flt_sc_custom_strict_dir(const float* blurp, int blpitch, void* dstp, int dpitch, std::array<float, 3>& opr,
-    float scale, int width, int height, float maxval, int32_t* dirp,
-    int dirpitch)
-{
-    emask<float, true, 2, true, true>(blurp, blpitch, dstp, dpitch, opr,
-        scale, width, height, maxval, dirp, dirpitch);
-}
+template <typename Td, bool SCALE, int OPERATOR, bool _STRICT, bool CALC_DIR,
+    bool NT>
+struct emask_kernel {
+    static constexpr emask_func_t func =
+        emask<Td, SCALE, OPERATOR, _STRICT, CALC_DIR>;
+};
 
+const emask_table_t emask_table_sse4 = make_emask_table<emask_kernel>();
@@ -25,10 +25,8 @@
 
 #include <type_traits>
 #include <algorithm>
-#include <unordered_map>
-#include <format>
 
-#include "tcannymod.hpp"
+#include "tcanny_core.hpp"
 #include "gaussian_blur.hpp"
 
 
@@ -106,88 +104,51 @@ gblur(const void* srcp, int spitch, float* hbuffp, int hbpitch, void* dstp,
 }
 
 
+template <typename Ts>
+struct cvt2flt_kernel {
+    static constexpr gblur_func_t func = convert_to_float<Ts>;
+};
+
+// the radius is not a template argument of the C routine.
+template <typename Ts, int RADIUS, typename Td>
+struct gblur_kernel {
+    static constexpr gblur_func_t func = gblur<Ts, Td>;
+};
+
+static const gblur_table_t gblur_table_c =
+    make_gblur_table<cvt2flt_kernel, gblur_kernel, 1>();
+
+
 gblur_t get_gblur(int bytes, arch_t arch, int radius, int mode)
 {
-    using std::format;
-    std::unordered_map<std::string, gblur_t> func;
-
     if (arch < USE_AVX512) radius = std::min(radius, 2);
     if (arch == USE_AVX512) radius = std::min(radius, 3);
     if (arch == NO_SIMD) radius = 1;
 
-    if (mode & mode_t::DO_NOT_BLUR) {
-        func[format("{}{}", a2s(NO_SIMD), 1)] = convert_to_float<uint8_t>;
-        func[format("{}{}", a2s(NO_SIMD), 2)] = convert_to_float<uint16_t>;
-        func[format("{}{}", a2s(NO_SIMD), 4)] = convert_to_float<float>;
-        func[format("{}{}", a2s(USE_SSE4), 1)] = cvt2flt_sse4_u8;
-        func[format("{}{}", a2s(USE_SSE4), 2)] = cvt2flt_sse4_u16;
-        func[format("{}{}", a2s(USE_SSE4), 4)] = cvt2flt_sse4_flt;
-        func[format("{}{}", a2s(USE_AVX2), 1)] = cvt2flt_avx2_u8;
-        func[format("{}{}", a2s(USE_AVX2), 2)] = cvt2flt_avx2_u16;
-        func[format("{}{}", a2s(USE_AVX2), 4)] = cvt2flt_avx2_flt;
-        func[format("{}{}", a2s(USE_AVX512), 1)] = cvt2flt_avx512_u8;
-        func[format("{}{}", a2s(USE_AVX512), 2)] = cvt2flt_avx512_u16;
-        func[format("{}{}", a2s(USE_AVX512), 4)] = cvt2flt_avx512_flt;
-
-        auto key = format("{}{}", a2s(arch), bytes);
-        return func.at(key);
+    const gblur_table_t* table;
+    switch (arch) {
+    case arch_t::NO_SIMD:
+        table = &gblur_table_c;
+        break;
+    case arch_t::USE_SSE4:
+        table = &gblur_table_sse4;
+        break;
+    case arch_t::USE_AVX2:
+        table = &gblur_table_avx2;
+        break;
+    default:
+        table = &gblur_table_avx512;
     }
+    int type = bytes == 1 ? 0 : bytes == 2 ? 1 : 2;
 
-    if (mode & mode_t::DO_BLUR_ONLY) {
-        func[format("{}{}{}", a2s(NO_SIMD), 1, 1)] = gblur<uint8_t, uint8_t>;
-        func[format("{}{}{}", a2s(NO_SIMD), 2, 1)] = gblur<uint16_t, uint16_t>;
-        func[format("{}{}{}", a2s(NO_SIMD), 4, 1)] = gblur<float, float>;
-        func[format("{}{}{}", a2s(USE_SSE4), 1, 1)] = gblur_sse4_u8_r1_u8;
-        func[format("{}{}{}", a2s(USE_SSE4), 1, 2)] = gblur_sse4_u8_r2_u8;
-        func[format("{}{}{}", a2s(USE_SSE4), 2, 1)] = gblur_sse4_u16_r1_u16;
-        func[format("{}{}{}", a2s(USE_SSE4), 2, 2)] = gblur_sse4_u16_r2_u16;
-        func[format("{}{}{}", a2s(USE_SSE4), 4, 1)] = gblur_sse4_flt_r1_flt;
-        func[format("{}{}{}", a2s(USE_SSE4), 4, 2)] = gblur_sse4_flt_r2_flt;
-        func[format("{}{}{}", a2s(USE_AVX2), 1, 1)] = gblur_avx2_u8_r1_u8;
-        func[format("{}{}{}", a2s(USE_AVX2), 1, 2)] = gblur_avx2_u8_r2_u8;
-        func[format("{}{}{}", a2s(USE_AVX2), 2, 1)] = gblur_avx2_u16_r1_u16;
-        func[format("{}{}{}", a2s(USE_AVX2), 2, 2)] = gblur_avx2_u16_r2_u16;
-        func[format("{}{}{}", a2s(USE_AVX2), 4, 1)] = gblur_avx2_flt_r1_flt;
-        func[format("{}{}{}", a2s(USE_AVX2), 4, 2)] = gblur_avx2_flt_r2_flt;
-        func[format("{}{}{}", a2s(USE_AVX512), 1, 1)] = gblur_avx512_u8_r1_u8;
-        func[format("{}{}{}", a2s(USE_AVX512), 1, 2)] = gblur_avx512_u8_r2_u8;
-        func[format("{}{}{}", a2s(USE_AVX512), 1, 3)] = gblur_avx512_u8_r3_u8;
-        func[format("{}{}{}", a2s(USE_AVX512), 2, 1)] = gblur_avx512_u16_r1_u16;
-        func[format("{}{}{}", a2s(USE_AVX512), 2, 2)] = gblur_avx512_u16_r2_u16;
-        func[format("{}{}{}", a2s(USE_AVX512), 2, 3)] = gblur_avx512_u16_r3_u16;
-        func[format("{}{}{}", a2s(USE_AVX512), 4, 1)] = gblur_avx512_flt_r1_flt;
-        func[format("{}{}{}", a2s(USE_AVX512), 4, 2)] = gblur_avx512_flt_r2_flt;
-        func[format("{}{}{}", a2s(USE_AVX512), 4, 3)] = gblur_avx512_flt_r3_flt;
-
-        auto key = format("{}{}{}", a2s(arch), bytes, radius);
-        return func.at(key);
+    if (mode & tcm_mode_t::DO_NOT_BLUR) {
+        return table->convert[type];
     }
-
-    func[format("{}{}{}", a2s(NO_SIMD),  1, 1)] = gblur<uint8_t, float>;
-    func[format("{}{}{}", a2s(NO_SIMD),  2, 1)] = gblur<uint16_t, float>;
-    func[format("{}{}{}", a2s(NO_SIMD),  4, 1)] = gblur<float, float>;
-    func[format("{}{}{}", a2s(USE_SSE4), 1, 1)] = gblur_sse4_u8_r1_flt;
-    func[format("{}{}{}", a2s(USE_SSE4), 1, 2)] = gblur_sse4_u8_r2_flt;
-    func[format("{}{}{}", a2s(USE_SSE4), 2, 1)] = gblur_sse4_u16_r1_flt;
-    func[format("{}{}{}", a2s(USE_SSE4), 2, 2)] = gblur_sse4_u16_r2_flt;
-    func[format("{}{}{}", a2s(USE_SSE4), 4, 1)] = gblur_sse4_flt_r1_flt;
-    func[format("{}{}{}", a2s(USE_SSE4), 4, 2)] = gblur_sse4_flt_r2_flt;
-    func[format("{}{}{}", a2s(USE_AVX2), 1, 1)] = gblur_avx2_u8_r1_flt;
-    func[format("{}{}{}", a2s(USE_AVX2), 1, 2)] = gblur_avx2_u8_r2_flt;
-    func[format("{}{}{}", a2s(USE_AVX2), 2, 1)] = gblur_avx2_u16_r1_flt;
-    func[format("{}{}{}", a2s(USE_AVX2), 2, 2)] = gblur_avx2_u16_r2_flt;
-    func[format("{}{}{}", a2s(USE_AVX2), 4, 1)] = gblur_avx2_flt_r1_flt;
-    func[format("{}{}{}", a2s(USE_AVX2), 4, 2)] = gblur_avx2_flt_r2_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 1, 1)] = gblur_avx512_u8_r1_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 1, 2)] = gblur_avx512_u8_r2_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 1, 3)] = gblur_avx512_u8_r3_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 2, 1)] = gblur_avx512_u16_r1_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 2, 2)] = gblur_avx512_u16_r2_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 2, 3)] = gblur_avx512_u16_r3_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 4, 1)] = gblur_avx512_flt_r1_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 4, 2)] = gblur_avx512_flt_r2_flt;
-    func[format("{}{}{}", a2s(USE_AVX512), 4, 3)] = gblur_avx512_flt_r3_flt;
-
-    auto key = format("{}{}{}", a2s(arch), bytes, radius);
-    return func.at(key);
+    if (!(mode & tcm_mode_t::DO_BLUR_ONLY)) {
+        return table->to_float[type][radius - 1];
+    }
+    if ((mode & tcm_mode_t::STREAM_OUTPUT) && arch == USE_AVX512) {
+        return gblur_table_avx512_nt[type][radius - 1];
+    }
+    return table->to_source[type][radius - 1];
 }
@@ -25,173 +25,79 @@
 #ifndef GAUSSIAN_BLUR_HPP
 #define GAUSSIAN_BLUR_HPP
 
-
-void cvt2flt_sse4_u8(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void cvt2flt_sse4_u16(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void cvt2flt_sse4_flt(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void gblur_sse4_u8_r1_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_u8_r2_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_u8_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_u8_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_u16_r1_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_u16_r2_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_u16_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_u16_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_flt_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_sse4_flt_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void cvt2flt_avx2_u8(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void cvt2flt_avx2_u16(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void cvt2flt_avx2_flt(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void gblur_avx2_u8_r1_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_u8_r2_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_u8_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_u8_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_u16_r1_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_u16_r2_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_u16_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_u16_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_flt_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx2_flt_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void cvt2flt_avx512_u8(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void cvt2flt_avx512_u16(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void cvt2flt_avx512_flt(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float);
-
-void gblur_avx512_u8_r1_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u8_r2_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u8_r3_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u8_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u8_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u8_r3_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u16_r1_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u16_r2_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u16_r3_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u16_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u16_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_u16_r3_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_flt_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_flt_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
-void gblur_avx512_flt_r3_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float);
-
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+
+using gblur_func_t = void(*)(const void* srcp, int spitch, float* hbuffp,
+    int hbpitch, void* dstp, int dpitch, int width, int height, int radius,
+    const float* weights, float maxval);
+
+constexpr int GBLUR_MAX_RADIUS = 3;
+
+// blur kernels of an arch, indexed by [source type][RADIUS - 1], where the
+// source type is 0: uint8_t, 1: uint16_t, 2: float.
+// radii beyond the maximum of the arch are nullptr.
+using gblur_set_t =
+    std::array<std::array<gblur_func_t, GBLUR_MAX_RADIUS>, 3>;
+
+struct gblur_table_t {
+    std::array<gblur_func_t, 3> convert;  // sigma = 0, indexed by source type
+    gblur_set_t to_float;                 // blur into the float scratch
+    gblur_set_t to_source;                // blur only, output has source type
+};
+
+
+template <template <typename, int, typename> class K, typename Ts,
+    bool TO_FLOAT, size_t... I>
+constexpr auto make_gblur_row(std::index_sequence<I...>)
+{
+    using Td = std::conditional_t<TO_FLOAT, float, Ts>;
+    std::array<gblur_func_t, GBLUR_MAX_RADIUS> row{};
+    ((row[I] = K<Ts, I + 1, Td>::func), ...);
+    return row;
+}
+
+// K<Ts, RADIUS, Td>::func is the kernel, for RADIUS up to MAX_RADIUS.
+// every entry is placed by the template arguments of its kernel, so that
+// the table cannot be mis-wired.
+template <template <typename, int, typename> class K, int MAX_RADIUS,
+    bool TO_FLOAT>
+constexpr gblur_set_t make_gblur_set()
+{
+    static_assert(0 < MAX_RADIUS && MAX_RADIUS <= GBLUR_MAX_RADIUS);
+    constexpr auto seq = std::make_index_sequence<MAX_RADIUS>();
+    return {
+        make_gblur_row<K, uint8_t, TO_FLOAT>(seq),
+        make_gblur_row<K, uint16_t, TO_FLOAT>(seq),
+        make_gblur_row<K, float, TO_FLOAT>(seq),
+    };
+}
+
+// C<Ts>::func converts the source to float without blurring.
+template <template <typename> class C,
+    template <typename, int, typename> class K, int MAX_RADIUS>
+constexpr gblur_table_t make_gblur_table()
+{
+    return {
+        { C<uint8_t>::func, C<uint16_t>::func, C<float>::func },
+        make_gblur_set<K, MAX_RADIUS, true>(),
+        make_gblur_set<K, MAX_RADIUS, false>(),
+    };
+}
+
+
+extern const gblur_table_t gblur_table_sse4;
+
+extern const gblur_table_t gblur_table_avx2;
+
+extern const gblur_table_t gblur_table_avx512;
+
+// non-temporal variants of gblur_table_avx512.to_source, for output planes
+// that are not read again.
+extern const gblur_set_t gblur_table_avx512_nt;
 
 #endif // GAUSSIAN_BLUR_HPP
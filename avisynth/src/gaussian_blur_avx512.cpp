@@ -23,7 +23,6 @@
 */
 
 
-#include <vector>
 #include <algorithm>
 #include "simd.hpp"
 #include "gaussian_blur.hpp"
@@ -40,7 +39,7 @@ convert_to_float(const void* srcp, int spitch, float*, int, void* dstp,
 
     if constexpr (is_same_v<Ts, float>) {
         for (int y = 0; y < height; ++y) {
-            memcpy(dstp, srcp, sizeof(Ts) * width);
+            memcpy(d, s, sizeof(Ts) * width);
             s += spitch;
             d += dpitch;
         }
@@ -57,7 +56,20 @@ convert_to_float(const void* srcp, int spitch, float*, int, void* dstp,
 }
 
 
-template <typename Td>
+template <bool NT>
+SFINLINE void
+store_block(float* dstp, const int blocks, __m512 s0, __m512 s1, __m512 s2,
+    __m512 s3)
+{
+    constexpr size_t step = sizeof(__m512) / sizeof(float);
+    store_nt<NT, __m512>(dstp, s0);
+    if (blocks > 1) store_nt<NT, __m512>(dstp + step, s1);
+    if (blocks > 2) store_nt<NT, __m512>(dstp + step * 2, s2);
+    if (blocks > 3) store_nt<NT, __m512>(dstp + step * 3, s3);
+}
+
+
+template <typename Td, bool NT>
 SFINLINE void
 hblur(float* srcp, const int spitch, Td* dstp, const int dpitch,
     const int width, const int radius, const float* weights, const int remains)
@@ -91,6 +103,9 @@ hblur(float* srcp, const int spitch, Td* dstp, const int dpitch,
 
     weights += radius;
     for (int x = 0; x < width; x += step4) {
+        // the last block of a row stores only the vectors which start within
+        // the row, as the pitch is not always a multiple of the block.
+        const int blocks = std::min<int>((width - x + step1 - 1) / step1, 4);
 
         __m512 sum00 = zero<__m512>(); __m512 sum01 = zero<__m512>();
         __m512 sum02 = zero<__m512>(); __m512 sum03 = zero<__m512>();
@@ -143,106 +158,88 @@ hblur(float* srcp, const int spitch, Td* dstp, const int dpitch,
             sum53 = fmadd<__m512>(k, loadu<__m512>(s5 + x + v + step3), sum53);
         }
         if constexpr (is_same_v<Td, float>) {
-            store<__m512>(d0 + x +     0, sum00);
-            store<__m512>(d0 + x + step1, sum01);
-            store<__m512>(d0 + x + step2, sum02);
-            store<__m512>(d0 + x + step3, sum03);
+            store_block<NT>(d0 + x, blocks, sum00, sum01, sum02, sum03);
 
             if (remains < 2) continue;
-            store<__m512>(d1 + x +     0, sum10);
-            store<__m512>(d1 + x + step1, sum11);
-            store<__m512>(d1 + x + step2, sum12);
-            store<__m512>(d1 + x + step3, sum13);
+            store_block<NT>(d1 + x, blocks, sum10, sum11, sum12, sum13);
 
             if (remains < 3) continue;
-            store<__m512>(d2 + x +     0, sum20);
-            store<__m512>(d2 + x + step1, sum21);
-            store<__m512>(d2 + x + step2, sum22);
-            store<__m512>(d2 + x + step3, sum23);
+            store_block<NT>(d2 + x, blocks, sum20, sum21, sum22, sum23);
 
             if (remains < 4) continue;
-            store<__m512>(d3 + x +     0, sum30);
-            store<__m512>(d3 + x + step1, sum31);
-            store<__m512>(d3 + x + step2, sum32);
-            store<__m512>(d3 + x + step3, sum33);
+            store_block<NT>(d3 + x, blocks, sum30, sum31, sum32, sum33);
 
             if (remains < 5) continue;
-            store<__m512>(d4 + x +     0, sum40);
-            store<__m512>(d4 + x + step1, sum41);
-            store<__m512>(d4 + x + step2, sum42);
-            store<__m512>(d4 + x + step3, sum43);
+            store_block<NT>(d4 + x, blocks, sum40, sum41, sum42, sum43);
 
             if (remains < 6) continue;
-            store<__m512>(d5 + x +     0, sum50);
-            store<__m512>(d5 + x + step1, sum51);
-            store<__m512>(d5 + x + step2, sum52);
-            store<__m512>(d5 + x + step3, sum53);
+            store_block<NT>(d5 + x, blocks, sum50, sum51, sum52, sum53);
         }
         else if constexpr (is_same_v<Td, uint16_t>) {
             __m512i data0 = cvtps_epu16<__m512i, __m512>(sum00, sum01);
             __m512i data1 = cvtps_epu16<__m512i, __m512>(sum02, sum03);
-            store<__m512i>(d0 + x, data0);
-            store<__m512i>(d0 + x + step2, data1);
+            store_nt<NT, __m512i>(d0 + x, data0);
+            if (blocks > 2) store_nt<NT, __m512i>(d0 + x + step2, data1);
             if (remains < 2) continue;
 
             data0 = cvtps_epu16<__m512i, __m512>(sum10, sum11);
             data1 = cvtps_epu16<__m512i, __m512>(sum12, sum13);
-            store<__m512i>(d1 + x, data0);
-            store<__m512i>(d1 + x + step2, data1);
+            store_nt<NT, __m512i>(d1 + x, data0);
+            if (blocks > 2) store_nt<NT, __m512i>(d1 + x + step2, data1);
             if (remains < 3) continue;
 
             data0 = cvtps_epu16<__m512i, __m512>(sum20, sum21);
             data1 = cvtps_epu16<__m512i, __m512>(sum22, sum23);
-            store<__m512i>(d2 + x, data0);
-            store<__m512i>(d2 + x + step2, data1);
+            store_nt<NT, __m512i>(d2 + x, data0);
+            if (blocks > 2) store_nt<NT, __m512i>(d2 + x + step2, data1);
             if (remains < 4) continue;
 
             data0 = cvtps_epu16<__m512i, __m512>(sum30, sum31);
             data1 = cvtps_epu16<__m512i, __m512>(sum32, sum33);
-            store<__m512i>(d3 + x, data0);
-            store<__m512i>(d3 + x + step2, data1);
+            store_nt<NT, __m512i>(d3 + x, data0);
+            if (blocks > 2) store_nt<NT, __m512i>(d3 + x + step2, data1);
             if (remains < 5) continue;
 
             data0 = cvtps_epu16<__m512i, __m512>(sum40, sum41);
             data1 = cvtps_epu16<__m512i, __m512>(sum42, sum43);
-            store<__m512i>(d4 + x, data0);
-            store<__m512i>(d4 + x + step2, data1);
+            store_nt<NT, __m512i>(d4 + x, data0);
+            if (blocks > 2) store_nt<NT, __m512i>(d4 + x + step2, data1);
             if (remains < 6) continue;
 
             data0 = cvtps_epu16<__m512i, __m512>(sum50, sum51);
             data1 = cvtps_epu16<__m512i, __m512>(sum52, sum53);
-            store<__m512i>(d5 + x, data0);
-            store<__m512i>(d5 + x + step2, data1);
+            store_nt<NT, __m512i>(d5 + x, data0);
+            if (blocks > 2) store_nt<NT, __m512i>(d5 + x + step2, data1);
         }
         else if constexpr (is_same_v<Td, uint8_t>) {
             __m512i data = cvtps_epu8_2(sum00, sum01, sum02, sum03);
-            store<__m512i>(d0 + x, data);
+            store_nt<NT, __m512i>(d0 + x, data);
             if (remains < 2) continue;
 
             data = cvtps_epu8_2(sum10, sum11, sum12, sum13);
-            store<__m512i>(d1 + x, data);
+            store_nt<NT, __m512i>(d1 + x, data);
             if (remains < 3) continue;
 
             data = cvtps_epu8_2(sum20, sum21, sum22, sum23);
-            store<__m512i>(d2 + x, data);
+            store_nt<NT, __m512i>(d2 + x, data);
             if (remains < 4) continue;
 
             data = cvtps_epu8_2(sum30, sum31, sum32, sum33);
-            store<__m512i>(d3 + x, data);
+            store_nt<NT, __m512i>(d3 + x, data);
             if (remains < 5) continue;
 
             data = cvtps_epu8_2(sum40, sum41, sum42, sum43);
-            store<__m512i>(d4 + x, data);
+            store_nt<NT, __m512i>(d4 + x, data);
             if (remains < 6) continue;
 
             data = cvtps_epu8_2(sum50, sum51, sum52, sum53);
-            store<__m512i>(d5 + x, data);
+            store_nt<NT, __m512i>(d5 + x, data);
         }
     }
 }
 
 
-template <typename Ts, int RADIUS, typename Td>
+template <typename Ts, int RADIUS, typename Td, bool NT = false>
 SFINLINE void gblur(const void* srcp, int spitch, float* hbuffp, int hbpitch, void* dstp,
     int dpitch, int width, int height, int radius, const float* weights,
     const float)
@@ -252,17 +249,21 @@ SFINLINE void gblur(const void* srcp, int spitch, float* hbuffp, int hbpitch, vo
 
     constexpr size_t step = sizeof(__m512) / sizeof(float);
     const int length = radius * 2 + 1;
-    std::vector<const Ts*> ptr(length + 5, nullptr);
+    LocalBuffer<const Ts*> ptr(length + 5);
     ptr[radius] = s;
     for (int r = 1; r <= radius; ++r) {
         ptr[radius + r] = s + r * spitch;
         ptr[radius - r] = ptr[radius + r];
     }
-    ptr[length + 0] = s + spitch * (radius + 1);
-    ptr[length + 1] = s + spitch * (radius + 2);
-    ptr[length + 2] = s + spitch * (radius + 3);
-    ptr[length + 3] = s + spitch * (radius + 4);
-    ptr[length + 4] = s + spitch * (radius + 5);
+    // rows below the plane are reflected, as the C routine does.
+    auto mirror = [height](int y) {
+        return y < height ? y : 2 * (height - 1) - y;
+    };
+    ptr[length + 0] = s + spitch * mirror(radius + 1);
+    ptr[length + 1] = s + spitch * mirror(radius + 2);
+    ptr[length + 2] = s + spitch * mirror(radius + 3);
+    ptr[length + 3] = s + spitch * mirror(radius + 4);
+    ptr[length + 4] = s + spitch * mirror(radius + 5);
 
     float* hb[6] = {
         hbuffp,
@@ -441,7 +442,8 @@ SFINLINE void gblur(const void* srcp, int spitch, float* hbuffp, int hbpitch, vo
             }
         }
         int remains = std::min(height - y, 6);
-        hblur(hbuffp, hbpitch, d, dpitch, width, radius, weights, remains);
+        hblur<Td, NT>(hbuffp, hbpitch, d, dpitch, width, radius, weights,
+            remains);
         d += dpitch * 6;
 
         for (int i = 0; i < 6; ++i) {
@@ -455,148 +457,32 @@ SFINLINE void gblur(const void* srcp, int spitch, float* hbuffp, int hbpitch, vo
             }
         }
     }
+    if constexpr (NT) {
+        _mm_sfence();
+    }
 }
 
 
+template <typename Ts>
+struct cvt2flt_kernel {
+    static constexpr gblur_func_t func = convert_to_float<Ts>;
+};
 
-void cvt2flt_avx512_u8(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float)
-{
-    convert_to_float<uint8_t>(srcp, spitch, 0, 0, dstp, dpitch, width, height,
-        0, nullptr, 0);
-}
-
-void cvt2flt_avx512_u16(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float)
-{
-    convert_to_float<uint16_t>(srcp, spitch, 0, 0, dstp, dpitch, width, height,
-        0, nullptr, 0);
-}
-
-void cvt2flt_avx512_flt(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float)
-{
-    convert_to_float<float>(srcp, spitch, 0, 0, dstp, dpitch, width, height,
-        0, nullptr, 0);
-}
-
-void gblur_avx512_u8_r1_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 1, uint8_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u8_r2_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 2, uint8_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u8_r3_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 3, uint8_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u8_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 1, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u8_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 2, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u8_r3_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 3, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u16_r1_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 1, uint16_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u16_r2_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 2, uint16_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u16_r3_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 3, uint16_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u16_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 1, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u16_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 2, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_u16_r3_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 3, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_avx512_flt_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<float, 1, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
+template <typename Ts, int RADIUS, typename Td>
+struct gblur_kernel {
+    static constexpr gblur_func_t func = gblur<Ts, RADIUS, Td>;
+};
 
-void gblur_avx512_flt_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<float, 2, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
+// non-temporal stores are used only where they measured faster:
+// 16bit or float output.
+template <typename Ts, int RADIUS, typename Td>
+struct gblur_kernel_nt {
+    static constexpr gblur_func_t func =
+        gblur<Ts, RADIUS, Td, (sizeof(Td) > 1)>;
+};
 
-void gblur_avx512_flt_r3_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<float, 3, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
+const gblur_table_t gblur_table_avx512 =
+    make_gblur_table<cvt2flt_kernel, gblur_kernel, 3>();
 
+const gblur_set_t gblur_table_avx512_nt =
+    make_gblur_set<gblur_kernel_nt, 3, false>();
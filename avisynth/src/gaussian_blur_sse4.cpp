@@ -23,7 +23,6 @@
 */
 
 
-#include <vector>
 #include <algorithm>
 #include "simd.hpp"
 #include "gaussian_blur.hpp"
@@ -34,7 +33,7 @@ SFINLINE void
 convert_to_float(const void* srcp, int spitch, float*, int, void* dstp,
     int dpitch, int width, int height, int, const float*, const float)
 {
-    constexpr size_t step = sizeof(__m128) / sizeof(Ts);
+    constexpr size_t step = sizeof(__m128) / sizeof(float);
     const Ts* s = reinterpret_cast<const Ts*>(srcp);
     float* d = reinterpret_cast<float*>(dstp);
 
@@ -118,10 +117,10 @@ hblur(float* srcp, const int spitch, Td* dstp, const int dpitch,
             if (remains < 2) continue;
             data = cvtps_epu16<__m128i, __m128>(sum10, sum11);
             store<__m128i>(d1 + x, data);
-            if (remains < 2) continue;
+            if (remains < 3) continue;
             data = cvtps_epu16<__m128i, __m128>(sum20, sum21);
             store<__m128i>(d2 + x, data);
-            if (remains < 3) continue;
+            if (remains < 4) continue;
             data = cvtps_epu16<__m128i, __m128>(sum30, sum31);
             store<__m128i>(d3 + x, data);
         }
@@ -131,10 +130,10 @@ hblur(float* srcp, const int spitch, Td* dstp, const int dpitch,
             if (remains < 2) continue;
             data = cvtps_epu8<__m128i, __m128>(sum10, sum11);
             storel(d1 + x, data);
-            if (remains < 2) continue;
+            if (remains < 3) continue;
             data = cvtps_epu8<__m128i, __m128>(sum20, sum21);
             storel(d2 + x, data);
-            if (remains < 3) continue;
+            if (remains < 4) continue;
             data = cvtps_epu8<__m128i, __m128>(sum30, sum31);
             storel(d3 + x, data);
         }
@@ -153,15 +152,19 @@ gblur(const void* srcp, int spitch, float* hbuffp, int hbpitch, void* dstp,
 
     constexpr size_t step = sizeof(__m128) / sizeof(float);
     const int length = radius * 2 + 1;
-    std::vector<const Ts*> ptr(length + 3, nullptr);
+    LocalBuffer<const Ts*> ptr(length + 3);
     ptr[radius] = s;
     for (int r = 1; r <= radius; ++r) {
         ptr[radius + r] = s + r * spitch;
         ptr[radius - r] = ptr[radius + r];
     }
-    ptr[length + 0] = s + spitch * (radius + 1);
-    ptr[length + 1] = s + spitch * (radius + 2);
-    ptr[length + 2] = s + spitch * (radius + 3);
+    // rows below the plane are reflected, as the C routine does.
+    auto mirror = [height](int y) {
+        return y < height ? y : 2 * (height - 1) - y;
+    };
+    ptr[length + 0] = s + spitch * mirror(radius + 1);
+    ptr[length + 1] = s + spitch * mirror(radius + 2);
+    ptr[length + 2] = s + spitch * mirror(radius + 3);
 
     float* hb[4] = {
         hbuffp,
@@ -260,103 +263,15 @@ gblur(const void* srcp, int spitch, float* hbuffp, int hbpitch, void* dstp,
 }
 
 
-void cvt2flt_sse4_u8(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float)
-{
-    convert_to_float<uint8_t>(srcp, spitch, 0, 0, dstp, dpitch, width, height,
-        0, nullptr, 0);
-}
-
-void cvt2flt_sse4_u16(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float)
-{
-    convert_to_float<uint16_t>(srcp, spitch, 0, 0, dstp, dpitch, width, height,
-        0, nullptr, 0);
-}
-
-void cvt2flt_sse4_flt(const void* srcp, int spitch, float*, int, void* dstp,
-    int dpitch, int width, int height, int, const float*, const float)
-{
-    convert_to_float<float>(srcp, spitch, 0, 0, dstp, dpitch, width, height,
-        0, nullptr, 0);
-}
-
-void gblur_sse4_u8_r1_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 1, uint8_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_sse4_u8_r2_u8(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 2, uint8_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_sse4_u8_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 1, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_sse4_u8_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint8_t, 2, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_sse4_u16_r1_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 1, uint16_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_sse4_u16_r2_u16(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 2, uint16_t>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_sse4_u16_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 1, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
-
-void gblur_sse4_u16_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<uint16_t, 2, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
+template <typename Ts>
+struct cvt2flt_kernel {
+    static constexpr gblur_func_t func = convert_to_float<Ts>;
+};
 
-void gblur_sse4_flt_r1_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<float, 1, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
+template <typename Ts, int RADIUS, typename Td>
+struct gblur_kernel {
+    static constexpr gblur_func_t func = gblur<Ts, RADIUS, Td>;
+};
 
-void gblur_sse4_flt_r2_flt(const void* srcp, int spitch, float* hbuffp,
-    int fbpitch, void* dstp, int dpitch, int width, int height, int radius,
-    const float* weights, float)
-{
-    gblur<float, 2, float>(srcp, spitch, hbuffp, fbpitch, dstp, dpitch,
-        width, height, radius, weights, 0);
-}
+const gblur_table_t gblur_table_sse4 =
+    make_gblur_table<cvt2flt_kernel, gblur_kernel, 2>();
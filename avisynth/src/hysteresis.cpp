@@ -24,15 +24,17 @@
 
 
 #include <vector>
-#include "tcannymod.hpp"
+#include <algorithm>
+#include <cstring>
+#include "tcanny_core.hpp"
 
 struct Pos {
     int x, y;
     Pos(int _x, int _y) : x(_x), y(_y) {}
-    template <typename Td>
+    template <typename Td, bool STATS>
     void search(const int width, const int height, float* emaskp, Td* dstp,
         const int epitch, const int dpitch, const float th, const Td maxv,
-        std::vector<Pos>& stack)
+        std::vector<Pos>& stack, HysteresisStats* hs)
     {
         std::array<Pos, 8> coordinates{
             Pos(x - 1, y - 1), Pos(x, y - 1), Pos(x + 1, y - 1), Pos(x - 1, y),
@@ -44,20 +46,48 @@ struct Pos {
             else {
                 auto posD = p.x + p.y * dpitch;
                 auto posE = p.x + p.y * epitch;
+                if constexpr (STATS) {
+                    ++hs->checks;
+                }
                 if (dstp[posD] == 0 && emaskp[posE] >= th) {
                     dstp[posD] = maxv;
                     stack.emplace_back(p);
+                    if constexpr (STATS) {
+                        ++hs->promoted;
+                    }
                 }
             }
         }
+        if constexpr (STATS) {
+            hs->peakStack = std::max(hs->peakStack,
+                static_cast<int64_t>(stack.size()));
+        }
+    }
+    template <typename Td>
+    void unmark(const int width, const int height, Td* dstp, const int dpitch,
+        std::vector<Pos>& stack)
+    {
+        std::array<Pos, 8> coordinates{
+            Pos(x - 1, y - 1), Pos(x, y - 1), Pos(x + 1, y - 1), Pos(x - 1, y),
+            Pos(x + 1, y), Pos(x - 1, y + 1), Pos(x, y + 1), Pos(x + 1, y + 1),
+        };
+        for (const auto& p : coordinates) {
+            if (p.x < 0 || p.x >= width || p.y < 0 || p.y >= height)
+                continue;
+            auto posD = p.x + p.y * dpitch;
+            if (dstp[posD] != 0) {
+                dstp[posD] = 0;
+                stack.emplace_back(p);
+            }
+        }
     }
 };
 
 
-template <typename Td>
+template <typename Td, bool STATS>
 static void hysteresis(void* dstp, const int dpitch, float* emaskp,
     const int epitch, const int width, const int height, const float tmin,
-    const float tmax, const float maxval)
+    const float tmax, const float maxval, HysteresisStats* hs)
 {
     Td* d = reinterpret_cast<Td*>(dstp);
     const Td maxv = static_cast<Td>(maxval);
@@ -74,22 +104,219 @@ static void hysteresis(void* dstp, const int dpitch, float* emaskp,
             }
             d[posD] = maxv;
             stack.emplace_back(x, y);
+            if constexpr (STATS) {
+                ++hs->seeds;
+            }
 
             do {
                 auto pos = stack.back();
                 stack.pop_back();
-                pos.search<Td>(width, height, emaskp, d, epitch, dpitch, tmin,
-                    maxv, stack);
+                pos.search<Td, STATS>(width, height, emaskp, d, epitch, dpitch,
+                    tmin, maxv, stack, hs);
             } while (!stack.empty());
         }
     }
 }
 
 
-hysteresis_t get_hysteresis(int bytes)
+template <typename Td, bool STATS>
+static void hysteresis_chain(void* dstp, const int dpitch, float* emaskp,
+    const int epitch, const int width, const int height, const float tmin,
+    const float tmax, const float maxval, EdgeChains& ec, HysteresisStats* hs)
 {
-    if (bytes == 1) return hysteresis<uint8_t>;
-    if (bytes == 2) return hysteresis<uint16_t>;
-    return hysteresis<float>;
+    Td* d = reinterpret_cast<Td*>(dstp);
+    const Td maxv = static_cast<Td>(maxval);
+
+    memset(d, 0, dpitch * height * sizeof(Td));
+    std::vector<Pos> stack, chain, dropped;
+    stack.reserve(512);
+    chain.reserve(512);
+    ec.clear();
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            auto posD = x + y * dpitch;
+            if (d[posD] > 0 || emaskp[x + y * epitch] < tmax) {
+                continue;
+            }
+            d[posD] = maxv;
+            stack.emplace_back(x, y);
+            chain.clear();
+            if constexpr (STATS) {
+                ++hs->seeds;
+            }
+
+            // every pixel of the chain is pushed once, so it is recorded
+            // when it is popped.
+            do {
+                auto pos = stack.back();
+                stack.pop_back();
+                chain.push_back(pos);
+                pos.search<Td, STATS>(width, height, emaskp, d, epitch, dpitch,
+                    tmin, maxv, stack, hs);
+            } while (!stack.empty());
+
+            // short chains keep maxv until the scan is finished, so that
+            // none of their pixels becomes a seed again.
+            if (chain.size() < ec.minlen) {
+                dropped.insert(dropped.end(), chain.begin(), chain.end());
+                ++ec.dropped;
+                continue;
+            }
+            if (!ec.record) {
+                continue;
+            }
+            int left = x, top = y, right = x, bottom = y;
+            for (const auto& p : chain) {
+                left = std::min(left, p.x);
+                top = std::min(top, p.y);
+                right = std::max(right, p.x);
+                bottom = std::max(bottom, p.y);
+            }
+            ec.pixels.push_back(static_cast<int64_t>(chain.size()));
+            ec.bbox.insert(ec.bbox.end(), { left, top, right, bottom });
+            if (ec.points) {
+                for (const auto& p : chain) {
+                    ec.coords.insert(ec.coords.end(), { p.x, p.y });
+                }
+            }
+        }
+    }
+
+    for (const auto& p : dropped) {
+        d[p.x + p.y * dpitch] = 0;
+    }
 }
 
+
+// dstp holds the edges of the previous frame on entry.
+// dirty has a flag for each row, and emaskp may differ from the previous
+// frame only on the flagged rows.
+template <typename Td>
+static void hysteresis_update(void* dstp, const int dpitch, float* emaskp,
+    const int epitch, const int width, const int height, const float tmin,
+    const float tmax, const float maxval, const uint8_t* dirty)
+{
+    Td* d = reinterpret_cast<Td*>(dstp);
+    const Td maxv = static_cast<Td>(maxval);
+
+    std::vector<Pos> stack, cleared;
+    stack.reserve(512);
+
+    // an old edge touching the dirty rows may have lost its seed or its
+    // connection, so it is removed as a whole and traced again.
+    for (int y = 0; y < height; ++y) {
+        if (!dirty[y]) {
+            continue;
+        }
+        for (int x = 0; x < width; ++x) {
+            auto posD = x + y * dpitch;
+            if (d[posD] == 0) {
+                continue;
+            }
+            d[posD] = 0;
+            stack.emplace_back(x, y);
+
+            do {
+                auto pos = stack.back();
+                stack.pop_back();
+                if (!dirty[pos.y]) {
+                    cleared.push_back(pos);
+                }
+                pos.unmark<Td>(width, height, d, dpitch, stack);
+            } while (!stack.empty());
+        }
+    }
+
+    auto trace = [&](int x, int y) {
+        auto posD = x + y * dpitch;
+        if (d[posD] > 0 || emaskp[x + y * epitch] < tmax) {
+            return;
+        }
+        d[posD] = maxv;
+        stack.emplace_back(x, y);
+
+        do {
+            auto pos = stack.back();
+            stack.pop_back();
+            pos.search<Td, false>(width, height, emaskp, d, epitch, dpitch,
+                tmin, maxv, stack, nullptr);
+        } while (!stack.empty());
+    };
+
+    // every edge that has to be traced again has a seed on the dirty rows
+    // or on the removed pixels.
+    for (int y = 0; y < height; ++y) {
+        if (!dirty[y]) {
+            continue;
+        }
+        for (int x = 0; x < width; ++x) {
+            trace(x, y);
+        }
+    }
+    for (const auto& p : cleared) {
+        trace(p.x, p.y);
+    }
+
+    // a kept edge next to the dirty rows may now be connected to pixels on
+    // them, which have no seed of their own.
+    for (int y = 0; y < height; ++y) {
+        if (dirty[y] || !((y > 0 && dirty[y - 1])
+            || (y < height - 1 && dirty[y + 1]))) {
+            continue;
+        }
+        for (int x = 0; x < width; ++x) {
+            if (d[x + y * dpitch] == 0) {
+                continue;
+            }
+            stack.emplace_back(x, y);
+
+            do {
+                auto pos = stack.back();
+                stack.pop_back();
+                pos.search<Td, false>(width, height, emaskp, d, epitch,
+                    dpitch, tmin, maxv, stack, nullptr);
+            } while (!stack.empty());
+        }
+    }
+}
+
+
+template <bool STATS>
+static hysteresis_t get_hysteresis_t(int bytes)
+{
+    if (bytes == 1) return hysteresis<uint8_t, STATS>;
+    if (bytes == 2) return hysteresis<uint16_t, STATS>;
+    return hysteresis<float, STATS>;
+}
+
+
+hysteresis_t get_hysteresis(int bytes, bool counting)
+{
+    return counting ? get_hysteresis_t<true>(bytes)
+        : get_hysteresis_t<false>(bytes);
+}
+
+
+template <bool STATS>
+static hysteresis_chain_t get_hysteresis_chain_t(int bytes)
+{
+    if (bytes == 1) return hysteresis_chain<uint8_t, STATS>;
+    if (bytes == 2) return hysteresis_chain<uint16_t, STATS>;
+    return hysteresis_chain<float, STATS>;
+}
+
+
+hysteresis_chain_t get_hysteresis_chain(int bytes, bool counting)
+{
+    return counting ? get_hysteresis_chain_t<true>(bytes)
+        : get_hysteresis_chain_t<false>(bytes);
+}
+
+
+hysteresis_update_t get_hysteresis_update(int bytes)
+{
+    if (bytes == 1) return hysteresis_update<uint8_t>;
+    if (bytes == 2) return hysteresis_update<uint16_t>;
+    return hysteresis_update<float>;
+}
@@ -0,0 +1,327 @@
+/*
+  morphology.cpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+// the stages after hysteresis that reshape an edge map in place: the
+// distance map of DistMap, and expand and inflate, which are the same as
+// chains of mt_expand and mt_inflate of masktools2 with the default
+// thresholds. for the latter, pixels beyond the plane are the nearest
+// pixels of the plane, as in masktools2.
+//
+// the stages of morphology run as a pipeline of rows: expand passes a row on as soon as
+// the rows below it are read, and each inflate as soon as the row below it
+// is passed. so the plane is read and written only once, and the rows in
+// flight stay in cache. the output of a row is written over the source
+// after the source is read, which is always N + M rows ahead.
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include "tcanny_core.hpp"
+#include "utils.hpp"
+
+
+template <typename T>
+class Morphology {
+    T* dst;
+    int dpitch;
+    int width;
+    int height;
+    int expand;
+    int inflate;
+    T maxv;
+
+    // expand of N is a square of 2N + 1. the rows of it are reduced to a
+    // flag per pixel, and count has the number of flags set in the column.
+    uint8_t* flags;
+    int fpitch;
+    int fslots;
+    uint16_t* count;
+
+    // output rows of each stage but the last, three each.
+    T* rings;
+    int rpitch;
+
+    int fed;                        // source rows read by expand
+    int emitted[MORPH_MAX + 1];     // rows passed on by each stage
+
+    T* row(int stage, int y) const noexcept
+    {
+        if (stage == inflate) {
+            return dst + static_cast<size_t>(y) * dpitch;
+        }
+        return rings + (static_cast<size_t>(stage) * 3 + y % 3) * rpitch;
+    }
+
+    uint8_t* flagRow(int y) const noexcept
+    {
+        return flags + static_cast<size_t>(y % fslots) * fpitch;
+    }
+
+    void feed(int y) noexcept
+    {
+        const T* s = dst + static_cast<size_t>(y) * dpitch;
+        uint8_t* f = flagRow(y);
+        const int n = expand;
+        // distance to the nearest edge on the left, and then on the right.
+        for (int x = 0, last = -n - 1; x < width; ++x) {
+            if (s[x] != 0) last = x;
+            f[x] = x - last <= n;
+        }
+        for (int x = width - 1, next = width + n; x >= 0; --x) {
+            if (s[x] != 0) next = x;
+            f[x] |= next - x <= n;
+        }
+        for (int x = 0; x < width; ++x) {
+            count[x] += f[x];
+        }
+        ++fed;
+    }
+
+    bool ready(int stage) const noexcept
+    {
+        int y = emitted[stage];
+        if (y >= height) {
+            return false;
+        }
+        if (stage == 0) {
+            return fed > std::min(y + expand, height - 1);
+        }
+        return emitted[stage - 1] > std::min(y + 1, height - 1);
+    }
+
+    void emitExpand(int y) noexcept
+    {
+        int drop = y - expand - 1;
+        if (drop >= 0) {
+            const uint8_t* f = flagRow(drop);
+            for (int x = 0; x < width; ++x) {
+                count[x] -= f[x];
+            }
+        }
+        T* d = row(0, y);
+        for (int x = 0; x < width; ++x) {
+            d[x] = count[x] > 0 ? maxv : T(0);
+        }
+    }
+
+    // the average of the eight neighbours if it is larger than the pixel.
+    void emitInflate(int stage, int y) noexcept
+    {
+        const T* a = row(stage - 1, std::max(y - 1, 0));
+        const T* c = row(stage - 1, y);
+        const T* b = row(stage - 1, std::min(y + 1, height - 1));
+        T* d = row(stage, y);
+        for (int x = 0; x < width; ++x) {
+            int L = std::max(x - 1, 0), R = std::min(x + 1, width - 1);
+            if constexpr (std::is_same_v<T, float>) {
+                float sum = a[L] + a[x] + a[R] + c[L] + c[R] + b[L] + b[x]
+                    + b[R];
+                d[x] = std::max(c[x], sum / 8.0f);
+            } else {
+                int sum = a[L] + a[x] + a[R] + c[L] + c[R] + b[L] + b[x]
+                    + b[R];
+                d[x] = std::max(c[x], static_cast<T>((sum + 4) >> 3));
+            }
+        }
+    }
+
+    // passes on the rows of a stage, each of which may let the next stage
+    // pass on its own rows. a ring is never overwritten before the next
+    // stage is done with the row.
+    void pump(int stage) noexcept
+    {
+        while (ready(stage)) {
+            int y = emitted[stage]++;
+            if (stage == 0) {
+                emitExpand(y);
+            } else {
+                emitInflate(stage, y);
+            }
+            if (stage < inflate) {
+                pump(stage + 1);
+            }
+        }
+    }
+
+public:
+    Morphology(void* dstp, int dp, int w, int h, int e, int i, float maxval,
+        void* buff) noexcept :
+        dst(reinterpret_cast<T*>(dstp)), dpitch(dp), width(w), height(h),
+        expand(e), inflate(i), maxv(static_cast<T>(maxval)), fed(0),
+        emitted{}
+    {
+        auto p = reinterpret_cast<uint8_t*>(buff);
+        size_t cpitch = plan_pitch(width * sizeof(uint16_t), SCRATCH_ALIGN);
+        count = reinterpret_cast<uint16_t*>(p);
+        memset(count, 0, cpitch);
+        fpitch = static_cast<int>(plan_pitch(width, SCRATCH_ALIGN));
+        fslots = 2 * expand + 2;
+        flags = p + cpitch;
+        rings = reinterpret_cast<T*>(
+            flags + static_cast<size_t>(fpitch) * fslots);
+        rpitch = static_cast<int>(
+            plan_pitch(width * sizeof(T), SCRATCH_ALIGN) / sizeof(T));
+    }
+
+    void run() noexcept
+    {
+        for (int y = 0; y < height; ++y) {
+            feed(y);
+            pump(0);
+        }
+    }
+};
+
+
+size_t morphology_size(int bytes, int width, int expand, int inflate)
+{
+    return plan_pitch(width * sizeof(uint16_t), SCRATCH_ALIGN)
+        + plan_pitch(width, SCRATCH_ALIGN) * (2 * expand + 2)
+        + plan_pitch(static_cast<size_t>(width) * bytes, SCRATCH_ALIGN) * 3
+        * inflate;
+}
+
+
+template <typename T>
+static void morphology(void* dstp, int dpitch, int width, int height,
+    int expand, int inflate, float maxval, void* buff)
+{
+    Morphology<T>(dstp, dpitch, width, height, expand, inflate, maxval, buff)
+        .run();
+}
+
+
+morphology_t get_morphology(int bytes)
+{
+    if (bytes == 1) return morphology<uint8_t>;
+    if (bytes == 2) return morphology<uint16_t>;
+    return morphology<float>;
+}
+
+
+size_t distance_size(int width, int height)
+{
+    size_t pitch = plan_pitch(width * sizeof(int32_t), SCRATCH_ALIGN);
+    return pitch * height + pitch * 2;
+}
+
+
+static inline int64_t floor_div(int64_t a, int64_t b) noexcept
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+
+// exact euclidean distance to the nearest edge (Meijster, Roerdink and
+// Hesselink, 2000), clamped to maxdist and scaled so that maxdist is maxval.
+// the first phase finds the distance in each column, by a pass down and a
+// pass up over whole rows. the second finds the lower envelope of the
+// parabolas of each row. the columns are capped to maxdist + 1, which does
+// not change any distance within maxdist.
+template <typename T>
+static void distance_transform(void* dstp, int dpitch, int width, int height,
+    int maxdist, float maxval, void* buff)
+{
+    T* d = reinterpret_cast<T*>(dstp);
+    const int gpitch = static_cast<int>(
+        plan_pitch(width * sizeof(int32_t), SCRATCH_ALIGN) / sizeof(int32_t));
+    int32_t* g = reinterpret_cast<int32_t*>(buff);
+    int32_t* s = g + static_cast<size_t>(gpitch) * height;
+    int32_t* t = s + gpitch;
+    const int32_t cap = maxdist + 1;
+
+    for (int y = 0; y < height; ++y) {
+        const T* src = d + static_cast<size_t>(y) * dpitch;
+        int32_t* gy = g + static_cast<size_t>(y) * gpitch;
+        const int32_t* above = y > 0 ? gy - gpitch : nullptr;
+        for (int x = 0; x < width; ++x) {
+            int32_t v = above ? std::min(above[x] + 1, cap) : cap;
+            gy[x] = src[x] != 0 ? 0 : v;
+        }
+    }
+    for (int y = height - 2; y >= 0; --y) {
+        int32_t* gy = g + static_cast<size_t>(y) * gpitch;
+        const int32_t* below = gy + gpitch;
+        for (int x = 0; x < width; ++x) {
+            gy[x] = std::min(gy[x], below[x] + 1);
+        }
+    }
+
+    const float k = maxval / maxdist;
+    const float ro = std::is_same_v<T, float> ? 0.0f : 0.5f;
+    const int64_t limit = static_cast<int64_t>(maxdist) * maxdist;
+    const T maxv = static_cast<T>(maxval);
+
+    for (int y = 0; y < height; ++y) {
+        const int32_t* gy = g + static_cast<size_t>(y) * gpitch;
+        T* dy = d + static_cast<size_t>(y) * dpitch;
+        auto f = [gy](int64_t x, int i) {
+            return (x - i) * (x - i) + int64_t(gy[i]) * gy[i];
+        };
+        auto sep = [gy](int64_t i, int64_t u) {
+            return floor_div(u * u - i * i + int64_t(gy[u]) * gy[u]
+                - int64_t(gy[i]) * gy[i], 2 * (u - i));
+        };
+
+        // s has the columns of the parabolas of the envelope, and t the
+        // first x where each of them is the lowest.
+        int q = 0;
+        s[0] = 0;
+        t[0] = 0;
+        for (int u = 1; u < width; ++u) {
+            while (q >= 0 && f(t[q], s[q]) > f(t[q], u)) {
+                --q;
+            }
+            if (q < 0) {
+                q = 0;
+                s[0] = u;
+            } else {
+                int64_t w = 1 + sep(s[q], u);
+                if (w < width) {
+                    ++q;
+                    s[q] = u;
+                    t[q] = static_cast<int32_t>(w);
+                }
+            }
+        }
+        for (int u = width - 1; u >= 0; --u) {
+            int64_t d2 = f(u, s[q]);
+            dy[u] = d2 >= limit ? maxv
+                : static_cast<T>(std::sqrt(static_cast<float>(d2)) * k + ro);
+            if (u == t[q]) {
+                --q;
+            }
+        }
+    }
+}
+
+
+distance_t get_distance(int bytes)
+{
+    if (bytes == 1) return distance_transform<uint8_t>;
+    if (bytes == 2) return distance_transform<uint16_t>;
+    return distance_transform<float>;
+}
@@ -0,0 +1,140 @@
+/*
+  perf_counters.cpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+#include <cstring>
+#include "perf_counters.hpp"
+
+
+#if defined(__linux__)
+
+static int open_event(uint32_t type, uint64_t config, int group) noexcept
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // kernel and hypervisor are excluded, which is allowed with the default
+    // perf_event_paranoid (2).
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group,
+        PERF_FLAG_FD_CLOEXEC));
+}
+
+
+PerfCounters::PerfCounters() noexcept
+{
+    static const struct { uint32_t type; uint64_t config; } events[] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    };
+    static_assert(sizeof(events) / sizeof(events[0]) == NUM_PERF_EVENTS);
+
+    for (auto& fd : fds) {
+        fd = -1;
+    }
+    // all or nothing, so that the values always belong to the same period.
+    for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+        fds[i] = open_event(events[i].type, events[i].config, fds[0]);
+        if (fds[i] < 0) {
+            for (int j = 0; j < i; ++j) {
+                close(fds[j]);
+                fds[j] = -1;
+            }
+            return;
+        }
+    }
+}
+
+
+PerfCounters::~PerfCounters()
+{
+    for (int i = NUM_PERF_EVENTS - 1; i >= 0; --i) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+}
+
+
+bool PerfCounters::read(uint64_t* values) const noexcept
+{
+    if (!available()) {
+        return false;
+    }
+    // nr followed by the values in the order of opening.
+    uint64_t buf[1 + NUM_PERF_EVENTS];
+    if (::read(fds[0], buf, sizeof(buf)) != sizeof(buf)
+            || buf[0] != NUM_PERF_EVENTS) {
+        return false;
+    }
+    memcpy(values, buf + 1, sizeof(uint64_t) * NUM_PERF_EVENTS);
+    return true;
+}
+
+
+PerfCounters* get_perf_counters() noexcept
+{
+    thread_local PerfCounters counters;
+    return counters.available() ? &counters : nullptr;
+}
+
+#else
+
+PerfCounters::PerfCounters() noexcept
+{
+    for (auto& fd : fds) {
+        fd = -1;
+    }
+}
+
+
+PerfCounters::~PerfCounters() {}
+
+
+bool PerfCounters::read(uint64_t*) const noexcept
+{
+    return false;
+}
+
+
+PerfCounters* get_perf_counters() noexcept
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+  perf_counters.hpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+// hardware counters of the calling thread. only Linux (perf_event_open) is
+// supported, and get_perf_counters() returns nullptr elsewhere.
+
+#ifndef TCANNY_PERF_COUNTERS_HPP
+#define TCANNY_PERF_COUNTERS_HPP
+
+#include <cstdint>
+
+
+enum perf_event_t {
+    EV_CYCLES,
+    EV_INSTRUCTIONS,
+    EV_L1D_MISSES,              // read misses of L1 data cache
+    EV_LLC_MISSES,              // misses of the last level cache
+    EV_BRANCH_MISSES,
+    NUM_PERF_EVENTS,
+};
+
+class PerfCounters {
+    int fds[NUM_PERF_EVENTS];
+
+public:
+    // opens the counters of the calling thread as a group, which counts
+    // only while the thread runs in user mode.
+    PerfCounters() noexcept;
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const noexcept { return fds[0] >= 0; }
+    // reads NUM_PERF_EVENTS values at once.
+    bool read(uint64_t* values) const noexcept;
+};
+
+
+// counters of the calling thread, opened on the first call. nullptr if the
+// system does not permit them (e.g. perf_event_paranoid, containers).
+PerfCounters* get_perf_counters() noexcept;
+
+
+#endif // TCANNY_PERF_COUNTERS_HPP
@@ -25,7 +25,10 @@
 #ifndef TCM_SIMD_HPP
 #define TCM_SIMD_HPP
 
+#include <cstdint>
+#include <cstring>
 #include <immintrin.h>
+#include <new>
 #include <type_traits>
 
 
@@ -40,6 +43,37 @@
 using std::is_same_v;
 
 
+namespace {
+
+// kernels do not use std containers. each *_sse4/avx2/avx512.cpp is built
+// with its own target flags, and the linker may keep the copy of an inline
+// std function instantiated there for the whole binary.
+// this class has internal linkage, so every translation unit has its own.
+template <typename T>
+class LocalBuffer {
+    T* ptr;
+public:
+    explicit LocalBuffer(size_t n) : ptr(nullptr)
+    {
+        if (n == 0) {
+            return;
+        }
+        ptr = static_cast<T*>(_mm_malloc(n * sizeof(T), 64));
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        memset(ptr, 0, n * sizeof(T));
+    }
+    ~LocalBuffer() { _mm_free(ptr); }
+    LocalBuffer(const LocalBuffer&) = delete;
+    LocalBuffer& operator=(const LocalBuffer&) = delete;
+    T& operator[](size_t i) { return ptr[i]; }
+    T* data() { return ptr; }
+};
+
+}
+
+
 template <typename T>
 SFINLINE T zero()
 {
@@ -153,7 +187,7 @@ SFINLINE void storeu(void* p, T& v)
         _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
     }
     else if constexpr (is_same_v<T, __m128>) {
-        _mm_store_ps(reinterpret_cast<float*>(p), v);
+        _mm_storeu_ps(reinterpret_cast<float*>(p), v);
     }
 #ifdef __AVX2__
     else if constexpr (is_same_v<T, __m256i>) {
@@ -191,15 +225,49 @@ SFINLINE void stream(void* p, T& v)
     }
 #ifdef __AVX512F__
     else if constexpr (is_same_v<T, __m512i>) {
-        _mm512_stream_si512(p, v);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(p), v);
     }
     else if constexpr (is_same_v<T, __m512>) {
-        _mm512_stream_ps(p, v);
+        _mm512_stream_ps(reinterpret_cast<float*>(p), v);
     }
 #endif
 #endif
 }
 
+// stores with a non-temporal hint when NT is true.
+template <bool NT, typename T>
+SFINLINE void store_nt(void* p, T& v)
+{
+    if constexpr (NT) {
+        stream<T>(p, v);
+    } else {
+        store<T>(p, v);
+    }
+}
+
+
+// copies a row to its final destination with non-temporal stores.
+// bytes before the first aligned address and after the last full vector
+// are copied normally.
+template <typename T>
+SFINLINE void stream_row(void* dstp, const void* srcp, size_t bytes)
+{
+    uint8_t* d = reinterpret_cast<uint8_t*>(dstp);
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(srcp);
+    size_t head = (sizeof(T) - reinterpret_cast<uintptr_t>(d) % sizeof(T))
+        % sizeof(T);
+    if (head > bytes) {
+        head = bytes;
+    }
+    memcpy(d, s, head);
+    size_t i = head;
+    for (; i + sizeof(T) <= bytes; i += sizeof(T)) {
+        T v = loadu<T>(s + i);
+        stream<T>(d + i, v);
+    }
+    memcpy(d + i, s + i, bytes - i);
+}
+
 template <typename T>
 SFINLINE void storel(void* p, const T& x)
 {
@@ -671,19 +739,19 @@ SFINLINE T rcp(const T& x)
 {
     if constexpr (is_same_v<T, __m128>) {
         __m128 t = _mm_rcp_ps(x);
-        return sub(add(t, t), mul(x, mul(t, t)));
+        return fsub(fadd(t, t), fmul(x, fmul(t, t)));
     }
 #ifdef __AVX2__
     else if constexpr (is_same_v<T, __m256>) {
         static const __m256 two = _mm256_set1_ps(2.0f);
         __m256 t = _mm256_rcp_ps(x);
-        return mul(t, _mm256_fnmadd_ps(x, t, two));
+        return fmul(t, _mm256_fnmadd_ps(x, t, two));
     }
 #ifdef __AVX512F__
     else if constexpr (std::is_same_v<T, __m512>) {
         static const __m512 two = _mm512_set1_ps(2.0f);
-        __m512 t = _mm512_pcp14_ps(x);
-        return mul(t, _mm512_fnmadd_ps(x, t, two));
+        __m512 t = _mm512_rcp14_ps(x);
+        return fmul(t, _mm512_fnmadd_ps(x, t, two));
     }
 #endif
 #endif
@@ -981,6 +1049,57 @@ SFINLINE Tr cmplt_ps(const Ta& x, const Ta& y)
 }
 
 
+// minimum and maximum of elements of type E (uint8_t, uint16_t or float).
+template <typename E, typename T>
+SFINLINE T min_as(const T& x, const T& y)
+{
+    if constexpr (is_same_v<E, float>) {
+        return fmin(x, y);
+    }
+    else if constexpr (is_same_v<T, __m128i>) {
+        if constexpr (is_same_v<E, uint8_t>) return _mm_min_epu8(x, y);
+        else return _mm_min_epu16(x, y);
+    }
+#ifdef __AVX2__
+    else if constexpr (is_same_v<T, __m256i>) {
+        if constexpr (is_same_v<E, uint8_t>) return _mm256_min_epu8(x, y);
+        else return _mm256_min_epu16(x, y);
+    }
+#ifdef __AVX512F__
+    else if constexpr (is_same_v<T, __m512i>) {
+        if constexpr (is_same_v<E, uint8_t>) return _mm512_min_epu8(x, y);
+        else return _mm512_min_epu16(x, y);
+    }
+#endif
+#endif
+}
+
+
+template <typename E, typename T>
+SFINLINE T max_as(const T& x, const T& y)
+{
+    if constexpr (is_same_v<E, float>) {
+        return fmax(x, y);
+    }
+    else if constexpr (is_same_v<T, __m128i>) {
+        if constexpr (is_same_v<E, uint8_t>) return _mm_max_epu8(x, y);
+        else return _mm_max_epu16(x, y);
+    }
+#ifdef __AVX2__
+    else if constexpr (is_same_v<T, __m256i>) {
+        if constexpr (is_same_v<E, uint8_t>) return _mm256_max_epu8(x, y);
+        else return _mm256_max_epu16(x, y);
+    }
+#ifdef __AVX512F__
+    else if constexpr (is_same_v<T, __m512i>) {
+        if constexpr (is_same_v<E, uint8_t>) return _mm512_max_epu8(x, y);
+        else return _mm512_max_epu16(x, y);
+    }
+#endif
+#endif
+}
+
+
 
 
 
@@ -0,0 +1,213 @@
+/*
+  stats.cpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include "stats.hpp"
+#include "tcanny_core.hpp"
+
+
+int LatencyHistogram::bucket(int64_t ns) noexcept
+{
+    if (ns < SUB) {
+        return ns < 0 ? 0 : static_cast<int>(ns);
+    }
+    int e = 63;
+    while ((static_cast<uint64_t>(ns) >> e) == 0) --e;
+    int sub = static_cast<int>(ns >> (e - SUB_BITS)) & (SUB - 1);
+    return (e - SUB_BITS + 1) * SUB + sub;
+}
+
+
+int64_t LatencyHistogram::upperBound(int b) noexcept
+{
+    if (b < SUB) {
+        return b;
+    }
+    int e = b / SUB + SUB_BITS - 1;
+    uint64_t sub = b % SUB;
+    uint64_t ub = ((SUB + sub + 1) << (e - SUB_BITS)) - 1;
+    return ub > INT64_MAX ? INT64_MAX : static_cast<int64_t>(ub);
+}
+
+
+void LatencyHistogram::add(int64_t ns) noexcept
+{
+    ++counts[bucket(ns)];
+    ++num;
+    sum += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+
+void LatencyHistogram::merge(const LatencyHistogram& other) noexcept
+{
+    for (int i = 0; i < BUCKETS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    num += other.num;
+    sum += other.sum;
+    maxNs = std::max(maxNs, other.maxNs);
+}
+
+
+int64_t LatencyHistogram::percentile(double p) const noexcept
+{
+    if (num == 0) {
+        return 0;
+    }
+    auto rank = static_cast<uint64_t>(p / 100.0 * num + 0.5);
+    rank = std::clamp<uint64_t>(rank, 1, num);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(upperBound(i), maxNs);
+        }
+    }
+    return maxNs;
+}
+
+
+static_assert(int(STAT_BLUR) == int(STAGE_BLUR)
+    && int(STAT_HYSTERESIS) == int(STAGE_HYSTERESIS)
+    && int(STAT_FRAME) == int(NUM_STAGES));
+
+
+static std::atomic<uint64_t> next_id{ 0 };
+
+
+StatsCollector::StatsCollector(const std::string& p) :
+    id(next_id.fetch_add(1, std::memory_order_relaxed)), path(p)
+{
+}
+
+
+void StatsCollector::setInfo(const std::string& key, int64_t value)
+{
+    info.emplace_back(key, std::to_string(value));
+}
+
+
+void StatsCollector::setInfo(const std::string& key, const std::string& value)
+{
+    std::string s = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') s += '\\';
+        s += c;
+    }
+    info.emplace_back(key, s + "\"");
+}
+
+
+StatsCollector::Slot& StatsCollector::addSlot()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    slots.push_back(std::make_unique<Slot>());
+    return *slots.back();
+}
+
+
+StatsCollector::Slot& StatsCollector::local()
+{
+    // ids are never reused, so the entries of destroyed collectors are
+    // just never matched again.
+    thread_local std::vector<std::pair<uint64_t, Slot*>> cache;
+    for (auto& [i, s] : cache) {
+        if (i == id) {
+            return *s;
+        }
+    }
+    auto& s = addSlot();
+    cache.emplace_back(id, &s);
+    return s;
+}
+
+
+bool StatsCollector::write()
+{
+    static const char* stat_names[] = {
+        "blur", "emask", "nms", "hysteresis", "frame", "scratch",
+    };
+    static const char* counter_names[] = {
+        "frames", "hyst_seeds", "hyst_promoted", "hyst_checks",
+    };
+    static_assert(std::size(stat_names) == NUM_STATS);
+    static_assert(std::size(counter_names) == NUM_COUNTERS);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    Slot total{};
+    for (const auto& s : slots) {
+        for (int i = 0; i < NUM_STATS; ++i) {
+            total.hist[i].merge(s->hist[i]);
+        }
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            total.counters[i] += s->counters[i];
+        }
+        total.peakStack = std::max(total.peakStack, s->peakStack);
+    }
+
+    FILE* fp = fopen(path.c_str(), "a");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "{\"version\": \"%s\", \"threads\": %zu", TCANNY_M_VERSION,
+        slots.size());
+    for (const auto& [key, value] : info) {
+        fprintf(fp, ", \"%s\": %s", key.c_str(), value.c_str());
+    }
+    fprintf(fp, ", \"counters\": {");
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        fprintf(fp, "%s\"%s\": %lld", i == 0 ? "" : ", ", counter_names[i],
+            static_cast<long long>(total.counters[i]));
+    }
+    fprintf(fp, ", \"hyst_peak_stack\": %lld}, \"stages\": {",
+        static_cast<long long>(total.peakStack));
+    for (int i = 0, first = 1; i < NUM_STATS; ++i) {
+        const auto& h = total.hist[i];
+        if (h.count() == 0) {
+            continue;
+        }
+        fprintf(fp, "%s\"%s\": {\"count\": %llu, \"mean_us\": %.3f, "
+            "\"p50_us\": %.3f, \"p95_us\": %.3f, \"p99_us\": %.3f, "
+            "\"max_us\": %.3f}", first ? "" : ", ", stat_names[i],
+            static_cast<unsigned long long>(h.count()), h.mean() * 1e-3,
+            h.percentile(50) * 1e-3, h.percentile(95) * 1e-3,
+            h.percentile(99) * 1e-3, h.max() * 1e-3);
+        first = 0;
+    }
+    fprintf(fp, "}}\n");
+    return fclose(fp) == 0;
+}
+
+
+std::string get_stats_path()
+{
+    const char* p = getenv("TCANNYMOD_STATS");
+    return p ? p : "";
+}
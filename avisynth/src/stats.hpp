@@ -0,0 +1,126 @@
+/*
+  stats.hpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+// statistics of a whole run, written as a line of JSON when it ends.
+// like tcanny_core.hpp, this is independent of the host application.
+
+#ifndef TCANNY_STATS_HPP
+#define TCANNY_STATS_HPP
+
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// histogram of latencies in nanoseconds. values below 8 have a bucket each,
+// and each power of two above is split into 8 buckets, so a percentile is
+// off by 12.5% at most.
+class LatencyHistogram {
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUB = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    std::array<uint64_t, BUCKETS> counts;
+    uint64_t num;
+    int64_t sum;
+    int64_t maxNs;
+
+    static int bucket(int64_t ns) noexcept;
+    static int64_t upperBound(int b) noexcept;
+
+public:
+    LatencyHistogram() noexcept : counts{}, num(0), sum(0), maxNs(0) {}
+    void add(int64_t ns) noexcept;
+    void merge(const LatencyHistogram& other) noexcept;
+    uint64_t count() const noexcept { return num; }
+    double mean() const noexcept { return num ? 1.0 * sum / num : 0.0; }
+    int64_t max() const noexcept { return maxNs; }
+    // p is in percent. the upper bound of the bucket is returned.
+    int64_t percentile(double p) const noexcept;
+};
+
+
+enum stat_t {
+    STAT_BLUR,                  // same order as stage_t
+    STAT_EMASK,
+    STAT_NMS,
+    STAT_HYSTERESIS,
+    STAT_FRAME,                 // main loop of a frame
+    STAT_SCRATCH,               // allocation of the scratch buffer
+    NUM_STATS,
+};
+
+enum counter_t {
+    COUNT_FRAMES,
+    COUNT_SEEDS,                // see HysteresisStats
+    COUNT_PROMOTED,
+    COUNT_CHECKS,
+    NUM_COUNTERS,
+};
+
+
+// collects statistics of all the threads that process frames.
+// each thread updates a slot of its own without locking. the mutex is
+// taken only when a thread sees the collector for the first time.
+// write() must not run together with the threads.
+class StatsCollector {
+public:
+    struct Slot {
+        LatencyHistogram hist[NUM_STATS];
+        int64_t counters[NUM_COUNTERS];
+        int64_t peakStack;      // largest of all the planes
+    };
+
+private:
+    uint64_t id;
+    std::string path;
+    std::vector<std::pair<std::string, std::string>> info; // JSON values
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Slot>> slots;
+
+    Slot& addSlot();
+
+public:
+    explicit StatsCollector(const std::string& path);
+
+    // constant information of the run, such as the kernels selected.
+    void setInfo(const std::string& key, int64_t value);
+    void setInfo(const std::string& key, const std::string& value);
+
+    // the slot of the calling thread.
+    Slot& local();
+
+    // appends the summary to the file as a line of JSON.
+    bool write();
+};
+
+
+// path set by the environment variable TCANNYMOD_STATS, or empty.
+std::string get_stats_path();
+
+
+#endif // TCANNY_STATS_HPP
@@ -0,0 +1,298 @@
+/*
+  tcanny.cpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <xmmintrin.h>
+#define TCANNY_BUILD
+#include "tcanny.h"
+#include "tcanny_core.hpp"
+
+static_assert(TCM_SCRATCH_ALIGN == SCRATCH_ALIGN);
+
+
+struct tcm_context {
+    TCannyCore core;
+    int bytes;
+    size_t windowSize;      // windows of SKIP_FLAT follow the scratch
+};
+
+
+static bool is_aligned(const void* p, ptrdiff_t pitch) noexcept
+{
+    return reinterpret_cast<uintptr_t>(p) % TCM_SCRATCH_ALIGN == 0
+        && pitch % TCM_SCRATCH_ALIGN == 0;
+}
+
+
+// same as create_* of the plugin.
+CoreParams get_core_params(const tcm_params& p)
+{
+    int mode = 0;
+    switch (p.filter) {
+    case TCM_FILTER_CANNY:
+        mode = tcm_mode_t::DETECT_EDGE | tcm_mode_t::CALC_DIRECTION
+            | tcm_mode_t::GENERATE_CANNY_IMAGE;
+        break;
+    case TCM_FILTER_GBLUR:
+        mode = tcm_mode_t::DO_BLUR_ONLY;
+        break;
+    case TCM_FILTER_EMASK:
+        mode = tcm_mode_t::DETECT_EDGE;
+        break;
+    case TCM_FILTER_DIRMAP:
+        mode = tcm_mode_t::DETECT_EDGE | tcm_mode_t::CALC_DIRECTION
+            | tcm_mode_t::SHOW_DIRECTION;
+        break;
+    case TCM_FILTER_DISTMAP:
+        mode = tcm_mode_t::DETECT_EDGE | tcm_mode_t::CALC_DIRECTION
+            | tcm_mode_t::GENERATE_CANNY_IMAGE | tcm_mode_t::DISTANCE_MAP;
+        break;
+    default:
+        throw std::runtime_error("unknown filter.");
+    }
+    const bool distmap = p.filter == TCM_FILTER_DISTMAP;
+    const bool canny = p.filter == TCM_FILTER_CANNY || distmap;
+    const bool magnitude = canny || p.filter == TCM_FILTER_EMASK;
+
+    validate(p.bits != 32 && (p.bits < 8 || p.bits > 16),
+        "bits must be 8 to 16 or 32.");
+    validate(p.width < 1 || p.height < 1,
+        "width and height must be greater than 0.");
+
+    CoreParams cp{};
+    cp.arch = get_arch(p.opt);
+    cp.bits = p.bits;
+    cp.maxval = p.max_value > 0.0f ? p.max_value
+        : p.bits == 32 ? 1.0f : 1.0f * (0xFF << (p.bits - 8));
+    cp.width = p.width;
+    cp.height = p.height;
+    cp.minWidth = p.min_width > 0 ? p.min_width : p.width;
+    cp.minHeight = p.min_height > 0 ? p.min_height : p.height;
+
+    cp.opr = parse_operator(p.op && magnitude ? p.op : "standard", mode);
+
+    cp.scale = magnitude ? p.scale : 1.0f;
+    validate(cp.scale <= 0.0f, "scale must be greater than zero.");
+    if (cp.scale != 1.0f) {
+        mode |= tcm_mode_t::SCALE_MAGNITUDE;
+    }
+
+    cp.sigma = p.sigma;
+    if (p.filter == TCM_FILTER_GBLUR) {
+        validate(p.sigma <= 0.0f, "sigma must be greater than zero.");
+    } else {
+        validate(p.sigma < 0.0f,
+            "sigma must be greater than or equal to zero.");
+        if (p.sigma == 0.0f) {
+            mode |= tcm_mode_t::DO_NOT_BLUR;
+        }
+    }
+
+    if (magnitude && p.strict) {
+        mode |= tcm_mode_t::STRICT_MAGNITUDE;
+    }
+
+    cp.tmin = { 0.0f };
+    cp.tmax = { 0.0f };
+    cp.percentile = p.percentile;
+    cp.ratio = p.ratio;
+    if (canny) {
+        validate(p.num_thresholds < 0 || (p.num_thresholds > 0
+            && (!p.t_l || !p.t_h)), "invalid thresholds.");
+        if (p.num_thresholds == 0) {
+            cp.tmin = { 1.0f };
+            cp.tmax = { 8.0f };
+        } else {
+            cp.tmin.assign(p.t_l, p.t_l + p.num_thresholds);
+            cp.tmax.assign(p.t_h, p.t_h + p.num_thresholds);
+        }
+        check_thresholds(cp.tmin, cp.tmax);
+
+        validate(p.minlen < 0, "minlen must be greater than or equal to 0.");
+        cp.minlen = p.minlen;
+
+        auto autoth = p.auto_threshold;
+        validate(autoth < 0 || autoth > 2, "auto_threshold must be 0, 1 or 2.");
+        if (autoth > 0) {
+            validate(cp.tmin.size() > 1,
+                "auto_threshold cannot be used with arrays of t_l/t_h.");
+            mode |= autoth == 1 ? tcm_mode_t::AUTO_PERCENTILE
+                : tcm_mode_t::AUTO_OTSU;
+        }
+        validate(p.percentile <= 0.0f || p.percentile >= 100.0f,
+            "percentile must be between 0 and 100.");
+        validate(p.ratio <= 0.0f || p.ratio >= 1.0f,
+            "ratio must be between 0 and 1.");
+    }
+    if (distmap) {
+        validate(p.radius < 1 || p.radius > DISTANCE_MAX,
+            "radius must be 1 to 1024.");
+        cp.maxDistance = p.radius;
+    }
+    if (p.skip_flat) {
+        validate(!magnitude || distmap,
+            "skip_flat is available only for TCannyMod and EMask.");
+        validate(canny && p.auto_threshold > 0,
+            "skip_flat cannot be used with auto_threshold.");
+        mode |= tcm_mode_t::SKIP_FLAT;
+    }
+
+    cp.mode = mode;
+    return cp;
+}
+
+
+void tcm_params_default(tcm_params* params, int filter)
+{
+    if (!params) {
+        return;
+    }
+    auto& p = *params;
+    memset(&p, 0, sizeof(p));
+    p.filter = filter;
+    p.bits = 8;
+    p.op = "standard";
+    p.scale = 1.0f;
+    p.sigma = 1.5f;
+    p.percentile = 80.0f;
+    p.ratio = 0.4f;
+    p.opt = -1;
+
+    if (filter == TCM_FILTER_CANNY) {
+        p.strict = 1;
+    } else if (filter == TCM_FILTER_DISTMAP) {
+        p.strict = 1;
+        p.radius = 16;
+    } else if (filter == TCM_FILTER_EMASK) {
+        p.scale = 5.1f;
+        p.sigma = 0.5f;
+    }
+}
+
+
+tcm_context* tcm_context_create(const tcm_params* params, char* error,
+    size_t error_size)
+{
+    try {
+        validate(!params, "params is NULL.");
+        auto cp = get_core_params(*params);
+        tcm_context* ctx = new tcm_context{ TCannyCore(cp), (cp.bits + 7) / 8,
+            0 };
+        if (cp.mode & tcm_mode_t::SKIP_FLAT) {
+            ctx->windowSize = ctx->core.windowSize(cp.width, cp.height);
+        }
+        return ctx;
+
+    } catch (std::exception& e) {
+        if (error && error_size > 0) {
+            snprintf(error, error_size, "%s", e.what());
+        }
+    }
+    return nullptr;
+}
+
+
+void tcm_context_destroy(tcm_context* ctx)
+{
+    delete ctx;
+}
+
+
+// the scratch of the core, followed by the windows if any.
+static size_t window_offset(const tcm_context* ctx) noexcept
+{
+    return (ctx->core.scratchSize() + TCM_SCRATCH_ALIGN - 1)
+        / TCM_SCRATCH_ALIGN * TCM_SCRATCH_ALIGN;
+}
+
+
+size_t tcm_scratch_size(const tcm_context* ctx)
+{
+    return ctx ? window_offset(ctx) + ctx->windowSize : 0;
+}
+
+
+void* tcm_scratch_alloc(const tcm_context* ctx)
+{
+    if (!ctx) {
+        return nullptr;
+    }
+    return _mm_malloc(tcm_scratch_size(ctx), TCM_SCRATCH_ALIGN);
+}
+
+
+void tcm_scratch_free(void* scratch)
+{
+    if (scratch) {
+        _mm_free(scratch);
+    }
+}
+
+
+int tcm_num_outputs(const tcm_context* ctx)
+{
+    return ctx ? ctx->core.numOutputs() : 0;
+}
+
+
+int tcm_process_plane(const tcm_context* ctx, void* scratch, const void* src,
+    ptrdiff_t src_pitch, void* dst, ptrdiff_t dst_pitch, int width,
+    int height)
+{
+    if (!ctx || !scratch || !src || !dst) {
+        return TCM_ERROR_INVALID_ARGUMENT;
+    }
+    const auto& core = ctx->core;
+    const int bytes = ctx->bytes;
+    if (!core.accepts(width, height) || !is_aligned(scratch, 0)
+        || !is_aligned(src, src_pitch) || !is_aligned(dst, dst_pitch)
+        || src_pitch < static_cast<ptrdiff_t>(width) * bytes
+        || dst_pitch < static_cast<ptrdiff_t>(width) * bytes
+        || src_pitch / bytes > INT_MAX || dst_pitch / bytes > INT_MAX) {
+        return TCM_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto srcp = reinterpret_cast<const uint8_t*>(src);
+        auto dstp = reinterpret_cast<uint8_t*>(dst);
+        const int spitch = static_cast<int>(src_pitch / bytes);
+        const int dpitch = static_cast<int>(dst_pitch / bytes);
+        if (ctx->windowSize > 0) {
+            core.processRegions(srcp, spitch, dstp, dpitch, width, height,
+                nullptr, nullptr, false, scratch,
+                reinterpret_cast<uint8_t*>(scratch) + window_offset(ctx),
+                nullptr);
+        } else {
+            core.process(srcp, spitch, dstp, dpitch, width, height, scratch,
+                nullptr);
+        }
+    } catch (std::bad_alloc&) {
+        return TCM_ERROR_OUT_OF_MEMORY;
+    }
+    return TCM_OK;
+}
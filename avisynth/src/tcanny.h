@@ -0,0 +1,131 @@
+/*
+  tcanny.h
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+/*
+  C API of libtcanny. it runs the filters of TCannyMod on planes in memory,
+  without AviSynth.
+
+  - a context holds the settings and the chosen kernels. it is not modified
+    after tcm_context_create(), so any number of threads can use it at once.
+  - all the memory written by a call is the scratch buffer and the output
+    given by the caller. each thread needs its own scratch buffer of
+    tcm_scratch_size() bytes, aligned to TCM_SCRATCH_ALIGN.
+  - pitches are in bytes. planes and pitches have to be aligned to
+    TCM_SCRATCH_ALIGN, as AviSynth+ frames are.
+*/
+
+#ifndef TCANNY_H
+#define TCANNY_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(TCANNY_BUILD)
+#define TCM_API __declspec(dllexport)
+#else
+#define TCM_API __declspec(dllimport)
+#endif
+#else
+#define TCM_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TCM_SCRATCH_ALIGN 64
+
+typedef enum tcm_filter {
+    TCM_FILTER_CANNY,       /* TCannyMod */
+    TCM_FILTER_GBLUR,       /* GBlur2 */
+    TCM_FILTER_EMASK,       /* EMask */
+    TCM_FILTER_DIRMAP,      /* DirMap */
+    TCM_FILTER_DISTMAP,     /* DistMap */
+} tcm_filter;
+
+typedef enum tcm_status {
+    TCM_OK = 0,
+    TCM_ERROR_INVALID_ARGUMENT = -1,
+    TCM_ERROR_OUT_OF_MEMORY = -2,
+} tcm_status;
+
+typedef struct tcm_params {
+    int filter;             /* tcm_filter */
+    int bits;               /* 8 to 16 (integer) or 32 (float) */
+    int width;              /* size of the largest plane to process */
+    int height;
+    int min_width;          /* size of the smallest plane to process. */
+    int min_height;         /* 0 means the same as width/height. */
+    float max_value;        /* value of edges. 0 means 0xFF << (bits - 8), */
+                            /* or 1.0 for float. */
+    const char* op;         /* "standard", "sobel", "prewitt" or "X Y Z" */
+    float scale;
+    float sigma;
+    int strict;
+    const float* t_l;       /* num_thresholds pairs of thresholds. */
+    const float* t_h;       /* 0 pairs means t_l=1.0 and t_h=8.0. */
+    int num_thresholds;
+    int minlen;
+    int auto_threshold;     /* 0: off, 1: percentile, 2: otsu */
+    float percentile;
+    float ratio;
+    int opt;                /* same as opt of TCannyMod. -1 is auto */
+    int radius;             /* DistMap only. 1 to 1024 */
+    int skip_flat;          /* TCannyMod and EMask only */
+} tcm_params;
+
+typedef struct tcm_context tcm_context;
+
+/* sets the defaults of the filter, which are the same as the plugin. */
+TCM_API void tcm_params_default(tcm_params* params, int filter);
+
+/* returns NULL on failure, and the reason is written to error if it is
+   not NULL. */
+TCM_API tcm_context* tcm_context_create(const tcm_params* params,
+    char* error, size_t error_size);
+
+TCM_API void tcm_context_destroy(tcm_context* ctx);
+
+TCM_API size_t tcm_scratch_size(const tcm_context* ctx);
+
+/* allocates a scratch buffer for ctx. it can be freed by any thread. */
+TCM_API void* tcm_scratch_alloc(const tcm_context* ctx);
+
+TCM_API void tcm_scratch_free(void* scratch);
+
+/* number of planes written to dst. each pair of thresholds yields its own
+   plane, and they are stacked vertically (dst has height * n rows). */
+TCM_API int tcm_num_outputs(const tcm_context* ctx);
+
+/* processes a plane, and returns one of tcm_status.
+   dst has the same sample type as src. */
+TCM_API int tcm_process_plane(const tcm_context* ctx, void* scratch,
+    const void* src, ptrdiff_t src_pitch, void* dst, ptrdiff_t dst_pitch,
+    int width, int height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCANNY_H */
@@ -0,0 +1,993 @@
+/*
+  tcanny_core.cpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "tcanny_core.hpp"
+#include "edgemask.hpp"
+#include "utils.hpp"
+
+
+TCannyCore::Planes TCannyCore::getPlanes(void* scratch) const
+{
+    auto orig = reinterpret_cast<uint8_t*>(scratch);
+    return {
+        reinterpret_cast<float*>(orig + layout.hbuff + hbPad),
+        reinterpret_cast<float*>(orig + layout.blur),
+        reinterpret_cast<float*>(orig + layout.emask),
+        reinterpret_cast<int32_t*>(orig + layout.dir),
+        reinterpret_cast<float*>(orig + layout.nms),
+        orig + layout.morph,
+        orig + layout.dist,
+    };
+}
+
+
+bool TCannyCore::accepts(int width, int height) const noexcept
+{
+    return width >= minWidth && width <= maxWidth
+        && height >= minHeight && height <= maxHeight;
+}
+
+
+// runs f, and adds its time (and its hardware counts if res has the
+// counters) to the stage if TIMING. the clock is not read at all otherwise.
+template <bool TIMING, typename F>
+static inline void timed(PlaneResult* res, stage_t stage, F&& f)
+{
+    if constexpr (TIMING) {
+        using namespace std::chrono;
+        uint64_t before[NUM_PERF_EVENTS], after[NUM_PERF_EVENTS];
+        const bool perf = res->perf && res->perf->read(before);
+        auto start = steady_clock::now();
+        f();
+        res->stageNs[stage] +=
+            duration_cast<nanoseconds>(steady_clock::now() - start).count();
+        if (perf && res->perf->read(after)) {
+            for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+                res->perfCounts[stage][i] += after[i] - before[i];
+            }
+        }
+    } else {
+        f();
+    }
+}
+
+
+void TCannyCore::process(const uint8_t* srcp, int spitch, uint8_t* dstp,
+    int dpitch, int width, int height, void* scratch, PlaneResult* res) const
+{
+    if (res && res->timing) {
+        run<true>(srcp, spitch, dstp, dpitch, width, height, scratch, res);
+    } else {
+        run<false>(srcp, spitch, dstp, dpitch, width, height, scratch, res);
+    }
+}
+
+
+void TCannyCore::processColor(const uint8_t* const* srcp, const int* spitch,
+    uint8_t* dstp, int dpitch, int width, int height, void* scratch,
+    PlaneResult* res) const
+{
+    if (res && res->timing) {
+        runColor<true>(srcp, spitch, dstp, dpitch, width, height, scratch, res);
+    } else {
+        runColor<false>(srcp, spitch, dstp, dpitch, width, height, scratch,
+            res);
+    }
+}
+
+
+template <bool TIMING>
+void TCannyCore::run(const uint8_t* srcp, int spitch, uint8_t* dstp,
+    int dpitch, int width, int height, void* scratch, PlaneResult* res) const
+{
+    auto buff = getPlanes(scratch);
+    operator_t o = opr;
+
+    if (mode & tcm_mode_t::DO_HYSTERESIS_ONLY) {
+        timed<TIMING>(res, STAGE_HYSTERESIS, [&] {
+            traceEdges(dstp, dpitch,
+                reinterpret_cast<float*>(const_cast<uint8_t*>(srcp)), spitch,
+                width, height, tmin, tmax, res);
+        });
+        return;
+    }
+    if (mode & tcm_mode_t::DO_BLUR_ONLY) {
+        timed<TIMING>(res, STAGE_BLUR, [&] {
+            gaussianBlur(srcp, spitch, buff.hbuff, hbPitch, dstp, dpitch,
+                width, height, radius, gbweights.data(), maxval);
+        });
+        return;
+    }
+    const float* blurp = buff.blurp;
+    int bpitch = blPitch;
+    if (readSource) {
+        blurp = reinterpret_cast<const float*>(srcp);
+        bpitch = spitch;
+    } else {
+        timed<TIMING>(res, STAGE_BLUR, [&] {
+            gaussianBlur(srcp, spitch, buff.hbuff, hbPitch, buff.blurp,
+                blPitch, width, height, radius, gbweights.data(), maxval);
+        });
+    }
+
+    if ((mode & tcm_mode_t::CALC_DIRECTION) == 0) {
+        timed<TIMING>(res, STAGE_EMASK, [&] {
+            edgeMask(blurp, bpitch, dstp, dpitch, o, scale,
+                width, height, maxval, nullptr, 0);
+        });
+        return;
+    }
+
+    if (mode & tcm_mode_t::OUTPUT_GRADIENT) {
+        timed<TIMING>(res, STAGE_EMASK, [&] {
+            edgeMask(blurp, bpitch, dstp, dpitch, o, scale, width,
+                height, maxval, buff.dirp, dirPitch);
+        });
+        if (res) {
+            res->dirp = buff.dirp;
+            res->dirPitch = dirPitch;
+        }
+        return;
+    }
+
+    timed<TIMING>(res, STAGE_EMASK, [&] {
+        edgeMask(blurp, bpitch, buff.emaskp, emPitch, o, scale, width,
+            height, maxval, buff.dirp, dirPitch);
+        if ((mode & tcm_mode_t::SHOW_DIRECTION)) {
+            writeDirections(buff.dirp, dirPitch, dstp, dpitch, width, height);
+        }
+    });
+    if ((mode & tcm_mode_t::SHOW_DIRECTION)) {
+        return;
+    }
+
+    runCanny<TIMING>(dstp, dpitch, width, height, buff, res);
+}
+
+
+template <bool TIMING>
+void TCannyCore::runColor(const uint8_t* const* srcp, const int* spitch,
+    uint8_t* dstp, int dpitch, int width, int height, void* scratch,
+    PlaneResult* res) const
+{
+    auto buff = getPlanes(scratch);
+    operator_t o = opr;
+
+    // the blurred planes are placed one after another.
+    const float* blurp[3];
+    timed<TIMING>(res, STAGE_BLUR, [&] {
+        for (int p = 0; p < 3; ++p) {
+            float* b = buff.blurp + static_cast<size_t>(p) * blPitch * maxHeight;
+            gaussianBlur(srcp[p], spitch[p], buff.hbuff, hbPitch, b, blPitch,
+                width, height, radius, gbweights.data(), maxval);
+            blurp[p] = b;
+        }
+    });
+
+    timed<TIMING>(res, STAGE_EMASK, [&] {
+        colorEdgeMask(blurp, blPitch, buff.emaskp, emPitch, o, scale, width,
+            height, maxval, buff.dirp, dirPitch);
+    });
+
+    runCanny<TIMING>(dstp, dpitch, width, height, buff, res);
+}
+
+
+template <bool TIMING>
+void TCannyCore::runCanny(uint8_t* dstp, int dpitch, int width, int height,
+    const Planes& buff, PlaneResult* res) const
+{
+    if (mode & (tcm_mode_t::AUTO_PERCENTILE | tcm_mode_t::AUTO_OTSU)) {
+        // thresholds are derived from the magnitudes that survive nms.
+        std::vector<float> lo(1), hi(1);
+        timed<TIMING>(res, STAGE_NMS, [&] {
+            std::vector<uint32_t> hist(NMS_HIST_BINS * NMS_HIST_LANES, 0);
+            nmsHistogram(buff.emaskp, emPitch, buff.dirp, dirPitch,
+                buff.nmsp, blPitch, width, height, binScale, hist.data());
+            autoThreshold(hist.data(), lo[0], hi[0]);
+        });
+        if (res) {
+            res->tl = lo[0];
+            res->th = hi[0];
+        }
+        timed<TIMING>(res, STAGE_HYSTERESIS, [&] {
+            traceEdges(dstp, dpitch, buff.nmsp, blPitch, width, height, lo,
+                hi, res);
+            shapeEdges(dstp, dpitch, width, height, buff);
+        });
+        return;
+    }
+
+    timed<TIMING>(res, STAGE_NMS, [&] {
+        nonMaximumSuppression(buff.emaskp, emPitch, buff.dirp, dirPitch,
+            buff.nmsp, blPitch, width, height);
+    });
+
+    timed<TIMING>(res, STAGE_HYSTERESIS, [&] {
+        traceEdges(dstp, dpitch, buff.nmsp, blPitch, width, height, tmin,
+            tmax, res);
+        shapeEdges(dstp, dpitch, width, height, buff);
+    });
+}
+
+
+void TCannyCore::shapeEdges(uint8_t* dstp, int dpitch, int width,
+    int height, const Planes& buff) const
+{
+    const bool morph = expand > 0 || inflate > 0;
+    const bool dist = mode & tcm_mode_t::DISTANCE_MAP;
+    if (!morph && !dist) {
+        return;
+    }
+    size_t outSize = static_cast<size_t>(dpitch) * bytes * height;
+    for (size_t t = 0; t < tmin.size(); ++t) {
+        if (morph) {
+            morphology(dstp + t * outSize, dpitch, width, height, expand,
+                inflate, maxval, buff.morphp);
+        }
+        if (dist) {
+            distanceTransform(dstp + t * outSize, dpitch, width, height,
+                maxDistance, maxval, buff.distp);
+        }
+    }
+}
+
+
+void TCannyCore::suppress(const float* srcp, int spitch, const int32_t* dirp,
+    int dirpitch, float* dstp, int dpitch, int width, int height) const
+{
+    nonMaximumSuppression(const_cast<float*>(srcp), spitch, dirp, dirpitch,
+        dstp, dpitch, width, height);
+}
+
+
+void TCannyCore::processTemporal(const uint8_t* srcp, int spitch,
+    const uint8_t* prevp, int ppitch, const uint8_t* prevdstp, int pdpitch,
+    float* nmsp, uint8_t* dstp, int dpitch, int width, int height,
+    void* scratch) const
+{
+    auto buff = getPlanes(scratch);
+    operator_t o = opr;
+    const bool reuse = prevp != nullptr;
+    const int numOut = static_cast<int>(tmin.size());
+    const int rowSize = width * bytes;
+    const size_t outSize = static_cast<size_t>(dpitch) * bytes * height;
+
+    // a changed source row affects nms within the radius of gaussian blur
+    // plus one row for edge detection and one row for nms.
+    const int halo = radius + 2;
+
+    std::vector<uint8_t> dirty(height, reuse ? 0 : 1);
+    if (reuse) {
+        std::vector<uint8_t> changed(height);
+        for (int y = 0; y < height; ++y) {
+            changed[y] = memcmp(srcp + y * spitch * bytes,
+                prevp + y * ppitch * bytes, rowSize) != 0;
+        }
+        for (int y = 0, last = -halo - 1; y < height; ++y) {
+            if (changed[y]) last = y;
+            dirty[y] = y - last <= halo;
+        }
+        for (int y = height - 1, next = height + halo; y >= 0; --y) {
+            if (changed[y]) next = y;
+            dirty[y] |= next - y <= halo;
+        }
+    }
+    auto numDirty = std::count(dirty.begin(), dirty.end(), 1);
+
+    // processing the whole plane at once is cheaper for large changes.
+    if (numDirty * 2 > height) {
+        gaussianBlur(srcp, spitch, buff.hbuff, hbPitch, buff.blurp, blPitch,
+            width, height, radius, gbweights.data(), maxval);
+        edgeMask(buff.blurp, blPitch, buff.emaskp, emPitch, o, scale, width,
+            height, maxval, buff.dirp, dirPitch);
+        nonMaximumSuppression(buff.emaskp, emPitch, buff.dirp, dirPitch, nmsp,
+            blPitch, width, height);
+        traceEdges(dstp, dpitch, nmsp, blPitch, width, height, tmin, tmax,
+            nullptr);
+        return;
+    }
+
+    for (int y = 0; y < height * numOut; ++y) {
+        memcpy(dstp + static_cast<size_t>(y) * dpitch * bytes,
+            prevdstp + static_cast<size_t>(y) * pdpitch * bytes, rowSize);
+    }
+    if (numDirty == 0) {
+        return;
+    }
+
+    for (int y = 0; y < height;) {
+        if (!dirty[y]) {
+            ++y;
+            continue;
+        }
+        // close runs of dirty rows share one window.
+        int top = y, bottom = y;
+        while (true) {
+            while (bottom < height && dirty[bottom]) ++bottom;
+            int next = bottom;
+            while (next < height && !dirty[next]) ++next;
+            if (next == height || next - bottom > 2 * halo) break;
+            bottom = next;
+        }
+
+        // rows within the halo from the edges of the window are not valid
+        // unless the window reaches the edges of the plane.
+        int start = std::max(top - halo, 0);
+        int h = std::min(bottom + halo, height) - start;
+        gaussianBlur(srcp + static_cast<size_t>(start) * spitch * bytes, spitch,
+            buff.hbuff, hbPitch, buff.blurp, blPitch, width, h, radius,
+            gbweights.data(), maxval);
+        edgeMask(buff.blurp, blPitch, buff.emaskp, emPitch, o, scale, width,
+            h, maxval, buff.dirp, dirPitch);
+        nonMaximumSuppression(buff.emaskp, emPitch, buff.dirp, dirPitch,
+            buff.nmsp, blPitch, width, h);
+        for (int r = top; r < bottom; ++r) {
+            memcpy(nmsp + r * blPitch, buff.nmsp + (r - start) * blPitch,
+                width * sizeof(float));
+        }
+        y = bottom;
+    }
+
+    // edges crossing the boundary of the dirty rows are traced again too.
+    std::vector<uint8_t> hdirty(height);
+    for (int y = 0; y < height; ++y) {
+        hdirty[y] = dirty[std::max(y - 1, 0)] | dirty[y]
+            | dirty[std::min(y + 1, height - 1)];
+    }
+    for (int t = 0; t < numOut; ++t) {
+        hysteresisUpdate(dstp + t * outSize, dpitch, nmsp, blPitch, width,
+            height, tmin[t], tmax[t], maxval, hdirty.data());
+    }
+}
+
+
+int TCannyCore::findActiveTiles(const uint8_t* srcp, int spitch, int width,
+    int height, int tile, uint8_t* active) const
+{
+    // ranges of the source are taken on cells, which are finer than the
+    // tiles, so that the reach of a tile is not much larger than needed.
+    constexpr int cell = 8;
+    const int cw = (width + cell - 1) / cell;
+    const int ch = (height + cell - 1) / cell;
+    std::vector<float> colMin(width), colMax(width);
+    std::vector<float> lo(static_cast<size_t>(cw) * ch);
+    std::vector<float> hi(lo.size());
+
+    for (int cy = 0; cy < ch; ++cy) {
+        int y0 = cy * cell;
+        tileRange(srcp + static_cast<size_t>(y0) * spitch * bytes, spitch,
+            width, std::min(cell, height - y0), colMin.data(), colMax.data());
+        for (int cx = 0; cx < cw; ++cx) {
+            auto x0 = cx * cell, x1 = std::min(width, x0 + cell);
+            lo[cy * cw + cx] = *std::min_element(&colMin[x0], &colMin[0] + x1);
+            hi[cy * cw + cx] = *std::max_element(&colMax[x0], &colMax[0] + x1);
+        }
+    }
+
+    // the magnitude of a pixel depends on the source within the radius of
+    // gaussian blur plus one pixel. nms only keeps or clears it.
+    const int reach = radius + 1;
+    const int tw = (width + tile - 1) / tile;
+    const int th = (height + tile - 1) / tile;
+    int count = 0;
+    for (int ty = 0; ty < th; ++ty) {
+        int top = std::max(ty * tile - reach, 0) / cell;
+        int bottom = std::min((ty + 1) * tile + reach, height) - 1;
+        for (int tx = 0; tx < tw; ++tx) {
+            int left = std::max(tx * tile - reach, 0) / cell;
+            int right = std::min((tx + 1) * tile + reach, width) - 1;
+            float l = lo[top * cw + left], h = hi[top * cw + left];
+            for (int y = top; y <= bottom / cell; ++y) {
+                for (int x = left; x <= right / cell; ++x) {
+                    l = std::min(l, lo[y * cw + x]);
+                    h = std::max(h, hi[y * cw + x]);
+                }
+            }
+            // blurred values lie between l and h but for rounding, which
+            // the margin covers along with that of edge detection.
+            float margin = std::max(std::abs(l), std::abs(h)) * 1e-4f;
+            float bound = flatGain * (h - l + margin) * 1.001f;
+            active[ty * tw + tx] = !(bound < flatLimit);
+            count += active[ty * tw + tx];
+        }
+    }
+    return count;
+}
+
+
+// windows are at least this wide, so that every kernel has a whole block
+// of a row to read (see emask_reads_in_place).
+constexpr int MIN_WINDOW_WIDTH = 128;
+
+// size of the tiles of a plane that mask and SKIP_FLAT are tested on.
+constexpr int REGION_TILE = 32;
+
+
+// pixels around a rectangle to process with it. with SKIP_FLAT, the pixels
+// around the rectangle have to be exact too, so that hysteresis does not
+// trace edges out of it.
+static inline int window_halo(int mode, int radius) noexcept
+{
+    return radius + ((mode & tcm_mode_t::SKIP_FLAT) ? 3 : 2);
+}
+
+
+size_t TCannyCore::windowSize(int width, int height) const noexcept
+{
+    const int halo = window_halo(mode, radius);
+    int w = std::min(maxWidth, std::max(width + 2 * halo, MIN_WINDOW_WIDTH));
+    int h = std::min(maxHeight, height + 2 * halo);
+    return plan_pitch(static_cast<size_t>(w) * bytes, SCRATCH_ALIGN) * h
+        * (1 + tmin.size());
+}
+
+
+// the pipeline runs on windows, each of which covers a rectangle to output
+// and its halo. blur, edge detection and nms inside the rectangle are the
+// same as for the whole plane, while hysteresis sees only the window.
+// with SKIP_FLAT, the rectangles hold the tiles whose output may not be 0.
+// tiles of an edge are always in the same rectangle, as edges do not cross
+// the other tiles, so the output is the same as for the whole plane.
+void TCannyCore::processRegions(const uint8_t* srcp, int spitch,
+    uint8_t* dstp, int dpitch, int width, int height, const Rect* roi,
+    const MaskPlane* mask, bool copy, void* scratch, uint8_t* winp,
+    PlaneResult* res) const
+{
+    const bool flat = !roi && !mask;
+    const int numOut = numOutputs();
+    const size_t outSize = static_cast<size_t>(dpitch) * bytes * height;
+    const int rowSize = width * bytes;
+    const int tw = (width + REGION_TILE - 1) / REGION_TILE;
+    const int th = (height + REGION_TILE - 1) / REGION_TILE;
+    const int halo = window_halo(mode, radius);
+
+    // tiles to output of SKIP_FLAT or mask.
+    std::vector<uint8_t> tiles;
+    if (flat) {
+        tiles.resize(static_cast<size_t>(tw) * th);
+        int n = findActiveTiles(srcp, spitch, width, height, REGION_TILE,
+            tiles.data());
+        if (n == tw * th) {
+            process(srcp, spitch, dstp, dpitch, width, height, scratch, res);
+            return;
+        }
+    } else if (mask) {
+        tiles.resize(static_cast<size_t>(tw) * th);
+        for (int ty = 0; ty < th; ++ty) {
+            int y1 = std::min(height, (ty + 1) * REGION_TILE);
+            for (int tx = 0; tx < tw; ++tx) {
+                int x1 = std::min(width, (tx + 1) * REGION_TILE);
+                bool hit = false;
+                for (int y = ty * REGION_TILE; y < y1 && !hit; ++y) {
+                    for (int x = tx * REGION_TILE; x < x1 && !hit; ++x) {
+                        hit = mask->at(x, y);
+                    }
+                }
+                tiles[ty * tw + tx] = hit;
+            }
+        }
+    }
+
+    for (int t = 0; t < numOut; ++t) {
+        for (int y = 0; y < height; ++y) {
+            auto d = dstp + t * outSize + static_cast<size_t>(y) * dpitch * bytes;
+            if (copy) {
+                memcpy(d, srcp + static_cast<size_t>(y) * spitch * bytes,
+                    rowSize);
+            } else {
+                memset(d, 0, rowSize);
+            }
+        }
+    }
+
+    std::vector<Rect> rects;
+    if (roi) {
+        rects.push_back(*roi);
+    } else {
+        // runs of tiles to output, in tiles. runs that are closer than two
+        // halos share one rectangle, as processTemporal merges runs of rows,
+        // and farther ones get their own, so that a rectangle does not span
+        // wide columns of other tiles. tiles next to a rectangle are never
+        // to output, which keeps edges inside a rectangle for SKIP_FLAT.
+        struct Box { int left, top, right, bottom; };
+        std::vector<Box> boxes;
+        auto near = [&](const Box& a, const Box& b) {
+            int gx = std::max(a.left, b.left) - std::min(a.right, b.right) - 1;
+            int gy = std::max(a.top, b.top) - std::min(a.bottom, b.bottom) - 1;
+            return std::max(gx, gy) * REGION_TILE <= 2 * halo;
+        };
+        auto add = [&](Box b) {
+            for (size_t i = 0; i < boxes.size();) {
+                if (!near(b, boxes[i])) {
+                    ++i;
+                    continue;
+                }
+                b.left = std::min(b.left, boxes[i].left);
+                b.top = std::min(b.top, boxes[i].top);
+                b.right = std::max(b.right, boxes[i].right);
+                b.bottom = std::max(b.bottom, boxes[i].bottom);
+                boxes[i] = boxes.back();
+                boxes.pop_back();
+                i = 0;
+            }
+            boxes.push_back(b);
+        };
+        for (int ty = 0; ty < th; ++ty) {
+            for (int tx = 0; tx < tw; ++tx) {
+                if (!tiles[ty * tw + tx]) {
+                    continue;
+                }
+                int l = tx;
+                while (tx + 1 < tw && tiles[ty * tw + tx + 1]) ++tx;
+                add({ l, ty, tx, ty });
+            }
+        }
+        for (const auto& b : boxes) {
+            int x0 = b.left * REGION_TILE, y0 = b.top * REGION_TILE;
+            rects.push_back({ x0, y0,
+                std::min(width, (b.right + 1) * REGION_TILE) - x0,
+                std::min(height, (b.bottom + 1) * REGION_TILE) - y0 });
+        }
+    }
+
+    for (const auto& r : rects) {
+        Rect w;
+        w.x = std::max(r.x - halo, 0);
+        w.y = std::max(r.y - halo, 0);
+        w.width = std::min(r.x + r.width + halo, width) - w.x;
+        w.height = std::min(r.y + r.height + halo, height) - w.y;
+        if (w.width < MIN_WINDOW_WIDTH) {
+            w.width = std::min(width, MIN_WINDOW_WIDTH);
+            w.x = std::min(w.x, width - w.width);
+        }
+
+        // the window is copied, so that the kernels see an aligned plane.
+        const int wpitch = static_cast<int>(
+            plan_pitch(static_cast<size_t>(w.width) * bytes, SCRATCH_ALIGN));
+        const size_t wsize = static_cast<size_t>(wpitch) * w.height;
+        uint8_t* ws = winp;
+        uint8_t* wd = winp + wsize;
+        for (int y = 0; y < w.height; ++y) {
+            memcpy(ws + static_cast<size_t>(y) * wpitch,
+                srcp + (static_cast<size_t>(w.y + y) * spitch + w.x) * bytes,
+                static_cast<size_t>(w.width) * bytes);
+        }
+        process(ws, wpitch / bytes, wd, wpitch / bytes, w.width, w.height,
+            scratch, res);
+
+        for (int t = 0; t < numOut; ++t) {
+            for (int y = r.y; y < r.y + r.height; ++y) {
+                auto s = wd + t * wsize + static_cast<size_t>(y - w.y) * wpitch
+                    + static_cast<size_t>(r.x - w.x) * bytes;
+                auto d = dstp + t * outSize
+                    + (static_cast<size_t>(y) * dpitch + r.x) * bytes;
+                if (flat) {
+                    // tiles of the row to output.
+                    const uint8_t* tr = &tiles[y / REGION_TILE * tw];
+                    for (int x = r.x; x < r.x + r.width; x += REGION_TILE) {
+                        if (tr[x / REGION_TILE]) {
+                            int n = std::min(REGION_TILE, width - x);
+                            memcpy(d + (x - r.x) * bytes, s + (x - r.x) * bytes,
+                                static_cast<size_t>(n) * bytes);
+                        }
+                    }
+                    continue;
+                }
+                if (!mask) {
+                    memcpy(d, s, static_cast<size_t>(r.width) * bytes);
+                    continue;
+                }
+                // runs of masked pixels.
+                for (int x = 0; x < r.width;) {
+                    if (!mask->at(r.x + x, y)) {
+                        ++x;
+                        continue;
+                    }
+                    int x0 = x;
+                    while (x < r.width && mask->at(r.x + x, y)) ++x;
+                    memcpy(d + x0 * bytes, s + x0 * bytes, (x - x0) * bytes);
+                }
+            }
+        }
+    }
+}
+
+
+void TCannyCore::autoThreshold(uint32_t* hist, float& lo, float& hi) const
+{
+    for (int l = 1; l < NMS_HIST_LANES; ++l) {
+        const uint32_t* h = hist + l * NMS_HIST_BINS;
+        for (int b = 0; b < NMS_HIST_BINS; ++b) {
+            hist[b] += h[b];
+        }
+    }
+
+    uint64_t total = 0;
+    double sum = 0.0;
+    for (int b = 0; b < NMS_HIST_BINS; ++b) {
+        total += hist[b];
+        sum += static_cast<double>(b) * hist[b];
+    }
+
+    int th = NMS_HIST_BINS - 1;
+    if (total > 0 && (mode & tcm_mode_t::AUTO_PERCENTILE)) {
+        auto target = static_cast<double>(total) * percentile / 100.0;
+        uint64_t count = 0;
+        for (th = 0; th < NMS_HIST_BINS - 1; ++th) {
+            count += hist[th];
+            if (count >= target) break;
+        }
+    } else if (total > 0) {
+        // otsu's method: maximize the between-class variance.
+        double w0 = 0.0, sum0 = 0.0, best = -1.0;
+        for (int b = 0; b < NMS_HIST_BINS - 1; ++b) {
+            w0 += hist[b];
+            sum0 += static_cast<double>(b) * hist[b];
+            double w1 = total - w0;
+            if (w0 == 0.0) continue;
+            if (w1 == 0.0) break;
+            double d = sum0 / w0 - (sum - sum0) / w1;
+            double var = w0 * w1 * d * d;
+            if (var > best) {
+                best = var;
+                th = b;
+            }
+        }
+    }
+
+    // upper bound of the bin.
+    hi = (th + 1) / binScale;
+    lo = hi * ratio;
+}
+
+
+void TCannyCore::traceEdges(uint8_t* dstp, int dpitch, float* emaskp,
+    int epitch, int width, int height, const std::vector<float>& lo,
+    const std::vector<float>& hi, PlaneResult* res) const
+{
+    auto numOut = static_cast<int>(lo.size());
+    size_t outSize = static_cast<size_t>(dpitch) * bytes * height;
+
+    const int c = res && res->counting ? 1 : 0;
+    HysteresisStats* hs = c ? &res->hyst : nullptr;
+
+    // blur, edge detection and nms are shared by all threshold pairs.
+    if (minlen == 0 && chains == 0) {
+        for (int t = 0; t < numOut; ++t) {
+            hysteresis[c](dstp + t * outSize, dpitch, emaskp, epitch, width,
+                height, lo[t], hi[t], maxval, hs);
+        }
+        return;
+    }
+
+    bool record = chains > 0 && res != nullptr;
+    EdgeChains discard;
+    if (record) {
+        res->chains.assign(numOut, EdgeChains{});
+    }
+
+    for (int t = 0; t < numOut; ++t) {
+        auto& ec = record ? res->chains[t] : discard;
+        ec.minlen = minlen;
+        ec.record = record;
+        ec.points = record && chains > 1;
+        hysteresisChain[c](dstp + t * outSize, dpitch, emaskp, epitch, width,
+            height, lo[t], hi[t], maxval, ec, hs);
+    }
+}
+
+
+void TCannyCore::generateWeights(float sigma)
+{
+    auto t = static_cast<int>(sigma * 3 + 0.5f);
+    radius = std::max(1, t);
+    validate(std::min(minWidth, minHeight) < radius, "sigma is too large");
+
+    int length = radius * 2 + 1;
+    gbweights.resize(length, 0.0f);
+
+    float sum = 0.0f;
+    for (int r = -radius; r <= radius; ++r) {
+        float weight = std::exp((-1 * r * r) / (2.0f * sigma * sigma));
+        gbweights[r + radius] = weight;
+        sum += weight;
+    }
+    for (int i = 0; i < length; ++i) {
+        gbweights[i] /= sum;
+    }
+}
+
+
+TCannyCore::TCannyCore(const CoreParams& p) :
+    mode(p.mode), tmin(p.tmin), tmax(p.tmax), scale(p.scale), arch(p.arch),
+    bits(p.bits), bytes((p.bits + 7) / 8), maxval(p.maxval), radius(0),
+    opr(p.opr), minlen(p.minlen), chains(p.chains),
+    percentile(p.percentile), ratio(p.ratio), expand(p.expand),
+    inflate(p.inflate), maxDistance(p.maxDistance), binScale(0.0f),
+    flatGain(0.0f),
+    flatLimit(0.0f), readSource(false), maxWidth(p.width), maxHeight(p.height),
+    minWidth(p.minWidth), minHeight(p.minHeight), hbPitch(0), hbPad(0),
+    blPitch(0), emPitch(0), dirPitch(0), nmsSize(0), layout(),
+    gaussianBlur(nullptr), edgeMask(nullptr), colorEdgeMask(nullptr),
+    writeDirections(nullptr),
+    nonMaximumSuppression(nullptr), nmsHistogram(nullptr),
+    hysteresis{}, hysteresisChain{}, hysteresisUpdate(nullptr),
+    tileRange(nullptr), morphology(nullptr), distanceTransform(nullptr)
+{
+    validate(tmin.empty() || tmin.size() != tmax.size(),
+        "t_l and t_h must have the same number of elements.");
+    validate(minWidth < 1 || minHeight < 1 || minWidth > maxWidth
+        || minHeight > maxHeight, "invalid plane size.");
+
+    // the output of GBlur2 and EMask is not read again by this filter, so it
+    // is written with non-temporal stores if it can not stay in cache anyway.
+    // the threshold is half of the last level cache, as other frames and
+    // threads share it.
+    size_t llc = get_llc_size();
+    bool finalOutput = (mode & tcm_mode_t::DO_BLUR_ONLY)
+        || ((mode & tcm_mode_t::DETECT_EDGE) && (mode & CALC_DIRECTION) == 0);
+    if (finalOutput && llc > 0
+        && static_cast<size_t>(maxWidth) * maxHeight * bytes >= llc / 2) {
+        mode |= tcm_mode_t::STREAM_OUTPUT;
+    }
+
+    constexpr int align = static_cast<int>(SCRATCH_ALIGN);
+    int bm = align - 1;
+
+    size_t hbSize = 0;
+    if ((mode & tcm_mode_t::DO_NOT_BLUR) == 0) {
+        generateWeights(p.sigma);
+        hbPad = (radius * sizeof(float) + bm) & ~bm;
+        hbPitch = static_cast<int>(
+            plan_pitch(2 * hbPad + maxWidth * sizeof(float), align));
+        hbSize = hbPitch * (arch == USE_AVX512 ? 6 : 4);
+        hbPitch /= sizeof(float);
+    }
+
+    size_t planeSize = 0, blSize = 0, emSize = 0, dirSize = 0;
+    if (mode & tcm_mode_t::DETECT_EDGE) {
+        blPitch = static_cast<int>(plan_pitch(maxWidth * sizeof(float), align));
+        planeSize = blPitch * maxHeight;
+        blSize = planeSize;
+        blPitch /= sizeof(float);
+    }
+
+    if (mode & tcm_mode_t::CALC_DIRECTION) {
+        dirPitch = blPitch;
+        dirSize = planeSize;
+        if ((mode & tcm_mode_t::OUTPUT_GRADIENT) == 0) {
+            emPitch = blPitch;
+            emSize = planeSize;
+        }
+    }
+
+    if (mode & GENERATE_CANNY_IMAGE) {
+        nmsSize = planeSize;
+    }
+
+    // expand and inflate of the edge map keep a few rows of their own.
+    size_t morphSize = 0;
+    validate(expand < 0 || inflate < 0 || expand > MORPH_MAX
+        || inflate > MORPH_MAX, "expand and inflate must be 0 to 64.");
+    if (expand > 0 || inflate > 0) {
+        validate((mode & tcm_mode_t::GENERATE_CANNY_IMAGE) == 0
+            || (mode & tcm_mode_t::TEMPORAL),
+            "expand and inflate are available only for canny.");
+        morphSize = morphology_size(bytes, maxWidth, expand, inflate);
+    }
+
+    // the distance map runs after hysteresis, so it shares memory with the
+    // planes of the earlier stages.
+    size_t distSize = 0;
+    if (mode & tcm_mode_t::DISTANCE_MAP) {
+        validate((mode & tcm_mode_t::GENERATE_CANNY_IMAGE) == 0
+            || (mode & tcm_mode_t::TEMPORAL),
+            "distance map is available only for canny.");
+        validate(maxDistance < 1 || maxDistance > DISTANCE_MAX,
+            "radius must be 1 to 1024.");
+        distSize = distance_size(maxWidth, maxHeight);
+    }
+
+    // a float source is passed to edgeMask in place if it is not blurred.
+    readSource = bits == 32 && (mode & tcm_mode_t::DETECT_EDGE)
+        && (mode & tcm_mode_t::DO_NOT_BLUR)
+        && (mode & (tcm_mode_t::TEMPORAL | tcm_mode_t::JOINT_COLOR)) == 0
+        && emask_reads_in_place(arch, minWidth);
+    if (readSource) {
+        blSize = 0;
+    }
+
+    // JOINT_COLOR blurs three planes before edge detection.
+    if (mode & tcm_mode_t::JOINT_COLOR) {
+        validate((mode & tcm_mode_t::GENERATE_CANNY_IMAGE) == 0
+            || (mode & (tcm_mode_t::TEMPORAL | tcm_mode_t::SKIP_FLAT)),
+            "joint color gradient is available only for canny.");
+        blSize *= 3;
+    }
+
+    // each region is live from the stage that writes it to the last stage
+    // that reads it. regions that are never live at once share memory.
+    enum { BLUR, EMASK, NMS, HYSTERESIS, DISTANCE };
+    std::vector<ScratchRegion> regions{
+        { hbSize, BLUR, BLUR, 0 },
+        { blSize, BLUR, EMASK, 0 },
+        { emSize, EMASK, NMS, 0 },
+        { dirSize, EMASK, NMS, 0 },
+        { nmsSize, NMS, HYSTERESIS, 0 },
+        { morphSize, HYSTERESIS, HYSTERESIS, 0 },
+        { distSize, DISTANCE, DISTANCE, 0 },
+    };
+    // the base of each region is shifted by a few more cache lines than the
+    // previous one, so that the planes read together are not 4K aliased.
+    constexpr size_t stagger = 3 * 64;
+    for (size_t i = 0; i < regions.size(); ++i) {
+        if (regions[i].size > 0) {
+            regions[i].size += stagger * i;
+        }
+    }
+    layout.total = std::max(plan_scratch(regions, align), size_t(align));
+    validate(scratch_overlaps(regions), "scratch regions overlap.");
+    for (size_t i = 0; i < regions.size(); ++i) {
+        if (regions[i].size > 0) {
+            regions[i].offset += stagger * i;
+            regions[i].size -= stagger * i;
+        }
+    }
+    layout.hbuff = regions[0].offset;
+    layout.blur = regions[1].offset;
+    layout.emask = regions[2].offset;
+    layout.dir = regions[3].offset;
+    layout.nms = regions[4].offset;
+    layout.morph = regions[5].offset;
+    layout.dist = regions[6].offset;
+    scratchRegions = std::move(regions);
+
+    gaussianBlur = get_gblur(bytes, arch, radius, mode);
+
+    edgeMask = get_emask(bytes, arch, mode);
+
+    colorEdgeMask = get_color_emask(arch);
+
+    morphology = get_morphology(bytes);
+
+    distanceTransform = get_distance(bytes);
+
+    writeDirections = get_write_dir(bytes);
+
+    nonMaximumSuppression = get_nms(arch);
+
+    nmsHistogram = get_nms_hist(arch);
+
+    if (mode & (tcm_mode_t::AUTO_PERCENTILE | tcm_mode_t::AUTO_OTSU)) {
+        // the edge mask clamps magnitudes to maxval when directions are
+        // calculated, of a single plane and of the joint gradient alike, so
+        // the histogram covers 0 to maxval.
+        binScale = NMS_HIST_BINS / maxval;
+    }
+
+    for (int c = 0; c < 2; ++c) {
+        hysteresis[c] = get_hysteresis(bytes, c == 1);
+        hysteresisChain[c] = get_hysteresis_chain(bytes, c == 1);
+    }
+
+    hysteresisUpdate = get_hysteresis_update(bytes);
+
+    if (mode & tcm_mode_t::SKIP_FLAT) {
+        const bool canny = mode & tcm_mode_t::GENERATE_CANNY_IMAGE;
+        validate(!canny && (mode & (tcm_mode_t::DETECT_EDGE
+            | tcm_mode_t::CALC_DIRECTION)) != tcm_mode_t::DETECT_EDGE,
+            "only canny and edge mask can skip flat tiles.");
+        validate(mode & (tcm_mode_t::AUTO_PERCENTILE | tcm_mode_t::AUTO_OTSU
+            | tcm_mode_t::TEMPORAL), "flat tiles cannot be skipped with "
+            "auto threshold or temporal mode.");
+        // gradients are differences of the blurred values weighted by the
+        // operator.
+        float k = std::abs(opr[0]) + std::abs(opr[1]) + std::abs(opr[2]);
+        float m = (mode & tcm_mode_t::STRICT_MAGNITUDE) ? std::sqrt(2.0f) : 2.0f;
+        flatGain = k * m * ((mode & tcm_mode_t::SCALE_MAGNITUDE) ? scale : 1.0f);
+        // hysteresis keeps nothing below the lowest t_l, and an integer edge
+        // mask rounds magnitudes below 0.5 to 0. a float edge mask is never
+        // surely 0, so nothing is skipped.
+        flatLimit = canny ? *std::min_element(tmin.begin(), tmin.end())
+            : bits == 32 ? 0.0f : 0.5f;
+        tileRange = get_tile_range(bytes, arch);
+    }
+}
+
+
+arch_t get_arch(int opt)
+{
+    if (opt == 0) {
+        return arch_t::NO_SIMD;
+    }
+    if (opt == 1) {
+        if (has_sse41()) return arch_t::USE_SSE4;
+        return arch_t::NO_SIMD;
+    }
+    if (opt == 2) {
+        if (has_avx2()) return arch_t::USE_AVX2;
+        if (has_sse41()) return arch_t::USE_SSE4;
+        return arch_t::NO_SIMD;
+    }
+    if (has_avx512()) return arch_t::USE_AVX512;
+    if (has_avx2()) return arch_t::USE_AVX2;
+    if (has_sse41()) return arch_t::USE_SSE4;
+    return arch_t::NO_SIMD;
+}
+
+
+operator_t parse_operator(const char* o, int& mode)
+{
+    std::string ostring(o);
+    if (ostring == "standard") {
+        mode |= tcm_mode_t::USE_STANDARD_OPERATOR;
+        return operator_t{ 0.0f, 1.0f, 0.0f };
+    } else if (ostring == "sobel") {
+        mode |= tcm_mode_t::USE_SOBEL_OPERATOR;
+        return operator_t{ 1.0f, 2.0f, 1.0f };
+    } else if (ostring == "prewitt") {
+        mode |= tcm_mode_t::USE_CUSTOM_OPERATOR;
+        return operator_t{ 1.0f, 1.0f, 1.0f };
+    }
+
+    try {
+        auto v = split(ostring, " ");
+        validate(v.size() != 3, nullptr);
+
+        operator_t opr;
+        opr[0] = std::stof(v[0]);
+        opr[1] = std::stof(v[1]);
+        opr[2] = std::stof(v[2]);
+        if (opr[0] == 0.0f && opr[1] == 1.0f && opr[2] == 0.0f) {
+            mode |= tcm_mode_t::USE_STANDARD_OPERATOR;
+        } else if (opr[0] == 1.0f && opr[1] == 2.0f && opr[2] == 1.0f) {
+            mode |= tcm_mode_t::USE_SOBEL_OPERATOR;
+        } else {
+            mode |= tcm_mode_t::USE_CUSTOM_OPERATOR;
+        }
+        return opr;
+    } catch (std::exception&) {
+        throw std::runtime_error("invalid operator is set.");
+    }
+}
+
+
+void check_thresholds(std::vector<float>& tmin, std::vector<float>& tmax)
+{
+    validate(tmin.empty() || tmax.empty(), "t_l/t_h must not be empty.");
+    if (tmin.size() == 1) tmin.resize(tmax.size(), tmin[0]);
+    if (tmax.size() == 1) tmax.resize(tmin.size(), tmax[0]);
+    validate(tmin.size() != tmax.size(),
+        "t_l and t_h must have the same number of elements.");
+    for (size_t i = 0; i < tmin.size(); ++i) {
+        validate(tmin[i] <= 0.0f, "t_l must be greater than 0.");
+        validate(tmax[i] <= tmin[i], "t_h must be greater than t_l.");
+    }
+}
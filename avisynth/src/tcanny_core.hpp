@@ -0,0 +1,479 @@
+/*
+  tcanny_core.hpp
+
+  This file is part of TCannyMod
+
+  Copyright (C) 2026 Oka Motofumi
+
+  Authors: Oka Motofumi (chikuzen.mo at gmail dot com)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+*/
+
+// everything in this header is independent of the host application.
+// TCannyMod (AviSynth+) and the C API of tcanny.h are built on it.
+
+#ifndef TCANNY_CORE_HPP
+#define TCANNY_CORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <array>
+#include "perf_counters.hpp"
+#include "utils.hpp"
+
+
+#define TCANNY_M_VERSION "2.0.0"
+
+enum arch_t : int32_t {
+    NO_SIMD,
+    USE_SSE4,
+    USE_AVX2,
+    USE_AVX512,
+};
+
+enum tcm_mode_t : int32_t {
+    AT_LEAST_V8 = 1 << 0,
+    DO_BLUR_ONLY = 1 << 1,
+    DO_NOT_BLUR = 1 << 2,
+    DETECT_EDGE = 1 << 3,
+    CALC_DIRECTION = 1 << 4,
+    SHOW_DIRECTION = 1 << 5,
+    GENERATE_CANNY_IMAGE = 1 << 6,
+    USE_STANDARD_OPERATOR = 1 << 7,
+    USE_SOBEL_OPERATOR = 1 << 8,
+    USE_CUSTOM_OPERATOR = 1 << 9,
+    STRICT_MAGNITUDE = 1 << 10,
+    SCALE_MAGNITUDE = 1 << 11,
+    DO_NOT_TOUCH_CHROMA = 1 << 12,
+    PROC_CHROMA = 1 << 13,
+    COPY_CHROMA = 1 << 14,
+    FILL_HALF_CHROMA = 1 << 15,
+    FILL_ZERO_CHROMA = 1 << 16,
+    SET_DEBUG_INFO = 1 << 17,
+    OUTPUT_GRADIENT = 1 << 18,
+    DO_NMS_ONLY = 1 << 19,
+    DO_HYSTERESIS_ONLY = 1 << 20,
+    TEMPORAL = 1 << 21,
+    AUTO_PERCENTILE = 1 << 22,
+    AUTO_OTSU = 1 << 23,
+    STREAM_OUTPUT = 1 << 24,
+    PROCESS_ROI = 1 << 25,
+    PROCESS_MASK = 1 << 26,
+    SKIP_FLAT = 1 << 27,
+    JOINT_COLOR = 1 << 28,
+    DISTANCE_MAP = 1 << 29,
+};
+
+using operator_t = std::array<float, 3>;
+
+using gblur_t = void(*)(
+    const void* srcp, int sstride, float* hbuffp, int hbpitch, void* dstp,
+    int dstride, int width, int height, int radius, const float* weights,
+    const float maxval);
+
+using edgemask_t = void(*)(
+    const float* blurp, int blpitch, void* dstp, int dpitch, operator_t& opr,
+    float scale, int width, int height, float maxval, int32_t* dirp,
+    int dirpitch);
+
+// magnitude and directions of the joint gradient of three planes.
+using color_emask_t = void(*)(
+    const float* const* blurp, int blpitch, float* dstp, int dpitch,
+    operator_t& opr, float scale, int width, int height, float maxval,
+    int32_t* dirp, int dirpitch);
+
+using write_direction_t = void(*)(
+    const int32_t* dirp, int dirpitch, void* dstp, int dpitch, int width,
+    int height);
+
+using nms_t = void(*)(
+    float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height);
+
+using nms_hist_t = void(*)(
+    float* emaskp, const int epitch, const int32_t* dirp, int dirpitch,
+    float* dstp, int dpitch, const int width, const int height,
+    const float binscale, uint32_t* hist);
+
+// min and max of each column of the rows, as float.
+using tile_range_t = void(*)(
+    const void* srcp, int spitch, int width, int height, float* minp,
+    float* maxp);
+
+// work done by hysteresis. the counting routines add to it.
+struct HysteresisStats {
+    int64_t seeds;              // strong pixels that start a trace
+    int64_t promoted;           // pixels joined to an edge by tracing
+    int64_t checks;             // neighbours examined while tracing
+    int64_t peakStack;          // largest number of pixels on the stack
+};
+
+using hysteresis_t = void(*)(
+    void* dstp, const int dpitch, float* emaskp, const int epitch,
+    const int width, const int height, const float tmin, const float tmax,
+    const float maxval, HysteresisStats* stats);
+
+
+// connected edge chains found by hysteresis.
+struct EdgeChains {
+    size_t minlen;                  // chains shorter than this are removed
+    bool record;                    // record statistics of kept chains
+    bool points;                    // record coordinates of kept chains
+    int64_t dropped;                // number of removed chains
+    std::vector<int64_t> pixels;    // number of pixels of each chain
+    std::vector<int64_t> bbox;      // left, top, right, bottom of each chain
+    std::vector<int64_t> coords;    // x, y of each pixel in traversal order
+    void clear()
+    {
+        dropped = 0;
+        pixels.clear();
+        bbox.clear();
+        coords.clear();
+    }
+};
+
+using hysteresis_chain_t = void(*)(
+    void* dstp, const int dpitch, float* emaskp, const int epitch,
+    const int width, const int height, const float tmin, const float tmax,
+    const float maxval, EdgeChains& chains, HysteresisStats* stats);
+
+using hysteresis_update_t = void(*)(
+    void* dstp, const int dpitch, float* emaskp, const int epitch,
+    const int width, const int height, const float tmin, const float tmax,
+    const float maxval, const uint8_t* dirty);
+
+// largest number of times of expand and inflate.
+constexpr int MORPH_MAX = 64;
+
+// expand and then inflate an edge map in place, like mt_expand and
+// mt_inflate. buff has morphology_size() bytes.
+using morphology_t = void(*)(
+    void* dstp, int dpitch, int width, int height, int expand, int inflate,
+    float maxval, void* buff);
+
+// largest maxdist of DistMap.
+constexpr int DISTANCE_MAX = 1024;
+
+// replaces an edge map with the distance to the nearest edge, in place.
+// buff has distance_size() bytes.
+using distance_t = void(*)(
+    void* dstp, int dpitch, int width, int height, int maxdist, float maxval,
+    void* buff);
+
+
+// offsets of the scratch regions in a scratch buffer.
+struct ScratchLayout {
+    size_t hbuff;
+    size_t blur;
+    size_t emask;
+    size_t dir;
+    size_t nms;
+    size_t morph;
+    size_t dist;
+    size_t total;
+};
+
+// alignment of scratch buffers and of the regions in them.
+constexpr size_t SCRATCH_ALIGN = 64;
+
+
+struct CoreParams {
+    int mode;                   // combination of tcm_mode_t
+    arch_t arch;
+    int bits;                   // 8 to 16, or 32 for float
+    float maxval;               // value of edges and largest source value
+    int width;                  // size of the largest plane
+    int height;
+    int minWidth;               // size of the smallest plane to process
+    int minHeight;
+    float sigma;
+    float scale;
+    operator_t opr;
+    std::vector<float> tmin;    // pairs of thresholds for hysteresis
+    std::vector<float> tmax;
+    int minlen;
+    int chains;
+    float percentile;
+    float ratio;
+    int expand;                 // times of expand and inflate of the output
+    int inflate;
+    int maxDistance;            // distances of DISTANCE_MAP are clamped to it
+};
+
+enum stage_t {
+    STAGE_BLUR,
+    STAGE_EMASK,                // includes write_directions of DirMap
+    STAGE_NMS,
+    STAGE_HYSTERESIS,           // includes morphology and distance map
+    NUM_STAGES,
+};
+
+// a rectangle of a plane.
+struct Rect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// luma of a mask read at the coordinates of a plane, which is subsampled
+// by ssw and ssh.
+struct MaskPlane {
+    const uint8_t* ptr;
+    int pitch;                  // in bytes
+    int bytes;
+    int ssw;
+    int ssh;
+
+    bool at(int x, int y) const noexcept
+    {
+        auto row = ptr + static_cast<size_t>(y << ssh) * pitch;
+        x <<= ssw;
+        if (bytes == 1) return row[x] != 0;
+        if (bytes == 2) return reinterpret_cast<const uint16_t*>(row)[x] != 0;
+        return reinterpret_cast<const float*>(row)[x] != 0.0f;
+    }
+};
+
+// per plane results other than the output image.
+struct PlaneResult {
+    const int32_t* dirp;        // directions of OUTPUT_GRADIENT (in scratch)
+    int dirPitch;
+    float tl;                   // thresholds chosen by auto threshold
+    float th;
+    std::vector<EdgeChains> chains; // an element per pair of thresholds
+    bool timing;                // measure the stages (set by the caller)
+    int64_t stageNs[NUM_STAGES];    // time of each stage is added if timing
+    bool counting;              // count the work of hysteresis (ditto)
+    HysteresisStats hyst;       // added for all pairs of thresholds
+    const PerfCounters* perf;   // read around each stage too if timing
+    uint64_t perfCounts[NUM_STAGES][NUM_PERF_EVENTS];
+};
+
+// the pipeline of a filter on a plane.
+// the settings are fixed in the constructor, and all the state of a call
+// lives in the scratch buffer given by the caller. thus, one instance can
+// be shared by any number of threads, each of which has its own scratch.
+// pitches are in elements, and each output holds a plane per pair of
+// thresholds, stacked vertically.
+class TCannyCore {
+    int mode;
+    std::vector<float> tmin;
+    std::vector<float> tmax;
+    float scale;
+    arch_t arch;
+    int bits;
+    int bytes;
+    float maxval;
+    int radius;
+    std::vector<float> gbweights;
+    operator_t opr;
+    int minlen;
+    int chains;
+    float percentile;
+    float ratio;
+    int expand;
+    int inflate;
+    int maxDistance;
+    float binScale;
+    float flatGain;             // largest magnitude per step of the source
+    float flatLimit;            // magnitudes below this output nothing
+    bool readSource;
+    int maxWidth;
+    int maxHeight;
+    int minWidth;
+    int minHeight;
+
+    int hbPitch;
+    int hbPad;
+    int blPitch;
+    int emPitch;
+    int dirPitch;
+    size_t nmsSize;
+    ScratchLayout layout;
+    std::vector<ScratchRegion> scratchRegions;
+
+    gblur_t gaussianBlur;
+    edgemask_t edgeMask;
+    color_emask_t colorEdgeMask;
+    write_direction_t writeDirections;
+    nms_t nonMaximumSuppression;
+    nms_hist_t nmsHistogram;
+    hysteresis_t hysteresis[2];             // [1] counts the work
+    hysteresis_chain_t hysteresisChain[2];
+    hysteresis_update_t hysteresisUpdate;
+    tile_range_t tileRange;
+    morphology_t morphology;
+    distance_t distanceTransform;
+
+    struct Planes {
+        float* hbuff;
+        float* blurp;
+        float* emaskp;
+        int32_t* dirp;
+        float* nmsp;
+        void* morphp;
+        void* distp;
+    };
+    Planes getPlanes(void* scratch) const;
+    void generateWeights(float sigma);
+    void autoThreshold(uint32_t* hist, float& lo, float& hi) const;
+    template <bool TIMING>
+    void run(const uint8_t* srcp, int spitch, uint8_t* dstp, int dpitch,
+        int width, int height, void* scratch, PlaneResult* res) const;
+    template <bool TIMING>
+    void runColor(const uint8_t* const* srcp, const int* spitch,
+        uint8_t* dstp, int dpitch, int width, int height, void* scratch,
+        PlaneResult* res) const;
+    // the rest of canny, from the magnitude and directions in scratch.
+    template <bool TIMING>
+    void runCanny(uint8_t* dstp, int dpitch, int width, int height,
+        const Planes& buff, PlaneResult* res) const;
+    // expand and inflate, or the distance map, of the edge map of each pair
+    // of thresholds.
+    void shapeEdges(uint8_t* dstp, int dpitch, int width, int height,
+        const Planes& buff) const;
+
+public:
+    TCannyCore(const CoreParams& p);
+
+    // size of the scratch buffer, which has to be aligned to SCRATCH_ALIGN.
+    size_t scratchSize() const noexcept { return layout.total; }
+    // bytes of the scratch buffer used by each region, with the stages in
+    // which it is live.
+    const std::vector<ScratchRegion>& getScratchRegions() const noexcept
+    {
+        return scratchRegions;
+    }
+    // size of the nms cache of temporal mode for a plane.
+    size_t nmsCacheSize() const noexcept { return nmsSize; }
+    int numOutputs() const noexcept { return static_cast<int>(tmin.size()); }
+    int getRadius() const noexcept { return radius; }
+    const std::vector<float>& getWeights() const noexcept { return gbweights; }
+    bool accepts(int width, int height) const noexcept;
+
+    void process(const uint8_t* srcp, int spitch, uint8_t* dstp, int dpitch,
+        int width, int height, void* scratch, PlaneResult* res) const;
+
+    // size of the buffer of windows of processRegions() for rectangles of
+    // up to width x height.
+    size_t windowSize(int width, int height) const noexcept;
+
+    // process of roi, of the pixels of mask, or of the tiles whose output
+    // may not be 0 (SKIP_FLAT, both are null). the rest of the output is 0,
+    // or the source if copy. each rectangle is processed in a window of its
+    // own with a halo, which is copied to winp.
+    void processRegions(const uint8_t* srcp, int spitch, uint8_t* dstp,
+        int dpitch, int width, int height, const Rect* roi,
+        const MaskPlane* mask, bool copy, void* scratch, uint8_t* winp,
+        PlaneResult* res) const;
+
+    // canny of JOINT_COLOR. the three planes of the same size yield a joint
+    // gradient, and a single edge map.
+    void processColor(const uint8_t* const* srcp, const int* spitch,
+        uint8_t* dstp, int dpitch, int width, int height, void* scratch,
+        PlaneResult* res) const;
+
+    // nms of CannyNMS. the magnitude is read in place.
+    void suppress(const float* srcp, int spitch, const int32_t* dirp,
+        int dirpitch, float* dstp, int dpitch, int width, int height) const;
+
+    // hysteresis of each pair of thresholds. chains are recorded to res.
+    void traceEdges(uint8_t* dstp, int dpitch, float* emaskp, int epitch,
+        int width, int height, const std::vector<float>& lo,
+        const std::vector<float>& hi, PlaneResult* res) const;
+
+    // marks the tiles of tile x tile pixels whose output may be other than
+    // 0 (SKIP_FLAT). active has a byte per tile, row by row, and the number
+    // of active tiles is returned.
+    int findActiveTiles(const uint8_t* srcp, int spitch, int width,
+        int height, int tile, uint8_t* active) const;
+
+    // canny of temporal mode. nmsp caches the nms of the plane, and prevp
+    // and prevdstp are the source and the output of the previous frame.
+    // they are reused if prevp is not null.
+    void processTemporal(const uint8_t* srcp, int spitch,
+        const uint8_t* prevp, int ppitch, const uint8_t* prevdstp,
+        int pdpitch, float* nmsp, uint8_t* dstp, int dpitch, int width,
+        int height, void* scratch) const;
+};
+
+template <typename T>
+static inline void validate(bool cond, const T message)
+{
+    if (cond)
+        throw std::runtime_error(message);
+}
+
+constexpr auto a2s(arch_t arch)
+{
+    if (arch == arch_t::NO_SIMD) return "NO_SIMD";
+    if (arch == arch_t::USE_SSE4) return "SSE4";
+    if (arch == arch_t::USE_AVX2)  return "AVX2";
+    return "AVX512";
+}
+
+
+arch_t get_arch(int opt);
+
+// "standard", "sobel", "prewitt" or "X Y Z". the operator flag is set to mode.
+operator_t parse_operator(const char* o, int& mode);
+
+// a single threshold is used for all pairs.
+void check_thresholds(std::vector<float>& tmin, std::vector<float>& tmax);
+
+struct tcm_params;
+
+// parameters of the C API (tcanny.h) checked as the filters do.
+CoreParams get_core_params(const tcm_params& p);
+
+
+gblur_t get_gblur(int bytes, arch_t arch, int radius, int mode);
+
+edgemask_t get_emask(int bytes, arch_t arch, int mode);
+
+bool emask_reads_in_place(arch_t arch, int width);
+
+color_emask_t get_color_emask(arch_t arch);
+
+write_direction_t get_write_dir(int bytes);
+
+nms_t get_nms(arch_t arch);
+
+nms_hist_t get_nms_hist(arch_t arch);
+
+tile_range_t get_tile_range(int bytes, arch_t arch);
+
+// the counting routines are separate, so that the others cost nothing.
+hysteresis_t get_hysteresis(int bytes, bool counting = false);
+
+hysteresis_chain_t get_hysteresis_chain(int bytes, bool counting = false);
+
+hysteresis_update_t get_hysteresis_update(int bytes);
+
+size_t morphology_size(int bytes, int width, int expand, int inflate);
+
+morphology_t get_morphology(int bytes);
+
+size_t distance_size(int width, int height);
+
+distance_t get_distance(int bytes);
+
+
+#endif // TCANNY_CORE_HPP
@@ -24,7 +24,8 @@
 
 
 #include <chrono>
-#include <format>
+#include <climits>
+#include <cstring>
 #include <algorithm>
 #include "tcannymod.hpp"
 #include "utils.hpp"
@@ -33,30 +34,26 @@
 struct Buffer {
     ise_t* env;
     bool isV8;
-    size_t size;
-    uint8_t* orig;
-    float* hbuff;
-    float* blurp;
-    float* emaskp;
-    int32_t* dirp;
-    Buffer(size_t hbsize, size_t blsize, size_t emsize, size_t dirsize,
-        size_t align, int hbpad, bool v8, ise_t* e) : env(e), isV8(v8),
-        size(emsize)
+    bool isHuge;
+    void* orig;
+    Buffer(size_t size, bool v8, ise_t* e) : env(e), isV8(v8), isHuge(false)
     {
-        size_t total = hbsize + blsize + emsize + dirsize;
-        void* p = isV8 ? env->Allocate(total, align, AVS_POOLED_ALLOC)
-            : avs_malloc(total, align);
+        void* p = acquire_scratch(size);
+        if (p) {
+            isHuge = true;
+        } else {
+            count_scratch(SCRATCH_DEFAULT);
+            p = isV8 ? env->Allocate(size, SCRATCH_ALIGN, AVS_POOLED_ALLOC)
+                : avs_malloc(size, SCRATCH_ALIGN);
+        }
         validate(!p, "failed to allocate temporal memory.");
-
-        orig = reinterpret_cast<uint8_t*>(p);
-        hbuff = reinterpret_cast<float*>(orig + hbpad);
-        blurp = reinterpret_cast<float*>(orig + hbsize);
-        emaskp = reinterpret_cast<float*>(orig + hbsize + blsize);
-        dirp = reinterpret_cast<int32_t*>(orig + hbsize + blsize + emsize);
+        orig = p;
     }
     ~Buffer()
     {
-        if (isV8) {
+        if (isHuge) {
+            release_scratch(orig);
+        } else if (isV8) {
             env->Free(orig);
         } else {
             avs_free(orig);
@@ -67,39 +64,179 @@ struct Buffer {
 };
 
 
-PVideoFrame __stdcall TCannyMod::getFrameDebug(int n, ise_t* env)
+// GetFrame of debug mode and of statistics, which need the times.
+PVideoFrame TCannyMod::getFrameTimed(int n, ise_t* env)
 {
     using namespace std::chrono;
+    const bool debug = mode & tcm_mode_t::SET_DEBUG_INFO;
+    const bool isV8 = debug || (mode & tcm_mode_t::AT_LEAST_V8);
 
-    Buffer buff(hbSize, blSize, emSize, dirSize, align, hbPad, true, env);
+    auto alloc = steady_clock::now();
+    Buffer buff(core->scratchSize(), isV8, env);
+    auto allocEnd = steady_clock::now();
     auto src = child->GetFrame(n, env);
-    auto dst = env->NewVideoFrameP(vi, &src);
+    auto dst = isV8 ? env->NewVideoFrameP(vi, &src) : env->NewVideoFrame(vi);
 
-    auto start = system_clock::now();
+    PlaneProfile prof[3] = {};
 
-    mainLoop(src, dst, buff, env);
+    auto start = steady_clock::now();
 
-    auto end = system_clock::now();
-    auto pt = duration_cast<microseconds>(end - start).count();
+    mainLoop(n, src, dst, buff, env, prof);
 
+    auto end = steady_clock::now();
 
+    if (stats) {
+        auto& slot = stats->local();
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            int64_t ns = 0;
+            for (int i = 0; i < numPlanes; ++i) {
+                ns += prof[i].stageNs[s];
+            }
+            // stages that do not run in this mode are not counted.
+            if (ns > 0) {
+                slot.hist[s].add(ns);
+            }
+        }
+        slot.hist[STAT_FRAME].add(
+            duration_cast<nanoseconds>(end - start).count());
+        slot.hist[STAT_SCRATCH].add(
+            duration_cast<nanoseconds>(allocEnd - alloc).count());
+        ++slot.counters[COUNT_FRAMES];
+        for (int i = 0; i < numPlanes; ++i) {
+            slot.counters[COUNT_SEEDS] += prof[i].hyst.seeds;
+            slot.counters[COUNT_PROMOTED] += prof[i].hyst.promoted;
+            slot.counters[COUNT_CHECKS] += prof[i].hyst.checks;
+            slot.peakStack = std::max(slot.peakStack, prof[i].hyst.peakStack);
+        }
+    }
+    if (!debug) {
+        return dst;
+    }
+
+    auto pt = duration_cast<microseconds>(end - start).count();
     auto map = env->getFramePropsRW(dst);
-    env->propSetInt(map, "TCM_gbradius", radius, PROPAPPENDMODE_APPEND);
+    env->propSetInt(map, "TCM_gbradius", core->getRadius(),
+        PROPAPPENDMODE_APPEND);
     env->propSetFloatArray(map, "TCM_gbkernel", dbgweights.data(),
         static_cast<int>(dbgweights.size()));
     env->propSetDataH(map, "TCM_opt", opt.c_str(), int(opt.length()),
         PROPDATATYPEHINT_UTF8, PROPAPPENDMODE_APPEND);
-    env->propSetInt(map, "GB_procTime", pt, PROPAPPENDMODE_APPEND);
+    env->propSetInt(map, "TCM_procTime", pt, PROPAPPENDMODE_APPEND);
+
+    // microseconds of each stage, an element per plane.
+    const char* names[] = {
+        "TCM_time_blur", "TCM_time_emask", "TCM_time_nms", "TCM_time_hyst",
+    };
+    static_assert(std::size(names) == NUM_STAGES);
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        double us[3];
+        for (int i = 0; i < numPlanes; ++i) {
+            us[i] = prof[i].stageNs[s] / 1000.0;
+        }
+        env->propSetFloatArray(map, names[s], us, numPlanes);
+    }
+
+    // work of hysteresis, an element per plane.
+    int64_t seeds[3], promoted[3], checks[3], peak[3];
+    for (int i = 0; i < numPlanes; ++i) {
+        seeds[i] = prof[i].hyst.seeds;
+        promoted[i] = prof[i].hyst.promoted;
+        checks[i] = prof[i].hyst.checks;
+        peak[i] = prof[i].hyst.peakStack;
+    }
+    env->propSetIntArray(map, "TCM_hyst_seeds", seeds, numPlanes);
+    env->propSetIntArray(map, "TCM_hyst_promoted", promoted, numPlanes);
+    env->propSetIntArray(map, "TCM_hyst_checks", checks, numPlanes);
+    env->propSetIntArray(map, "TCM_hyst_peak_stack", peak, numPlanes);
+
+    // ipc, and l1d, llc and branch misses per pixel of each stage,
+    // four elements per plane.
+    if (std::any_of(prof, prof + numPlanes,
+            [](const PlaneProfile& p) { return p.perf; })) {
+        const char* perfNames[] = {
+            "TCM_perf_blur", "TCM_perf_emask", "TCM_perf_nms",
+            "TCM_perf_hyst",
+        };
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            double v[3 * 4] = {};
+            for (int i = 0; i < numPlanes; ++i) {
+                const auto& c = prof[i].perfCounts[s];
+                if (!prof[i].perf || prof[i].pixels == 0
+                        || c[EV_CYCLES] == 0) {
+                    continue;
+                }
+                double px = static_cast<double>(prof[i].pixels);
+                v[i * 4 + 0] = 1.0 * c[EV_INSTRUCTIONS] / c[EV_CYCLES];
+                v[i * 4 + 1] = c[EV_L1D_MISSES] / px;
+                v[i * 4 + 2] = c[EV_LLC_MISSES] / px;
+                v[i * 4 + 3] = c[EV_BRANCH_MISSES] / px;
+            }
+            env->propSetFloatArray(map, perfNames[s], v, numPlanes * 4);
+        }
+    }
+    env->propSetInt(map, "TCM_scratch",
+        static_cast<int64_t>(core->scratchSize()), PROPAPPENDMODE_APPEND);
+    const int64_t paths[] = {
+        get_scratch_count(SCRATCH_HUGETLB),
+        get_scratch_count(SCRATCH_THP),
+        get_scratch_count(SCRATCH_DEFAULT),
+    };
+    env->propSetIntArray(map, "TCM_scratch_paths", paths, NUM_SCRATCH_PATHS);
 
     return dst;
 }
 
 
-void TCannyMod::mainLoop(PVideoFrame& src, PVideoFrame& dst, Buffer& buff,
-    ise_t* env)
+void TCannyMod::mainLoop(int n, PVideoFrame& src, PVideoFrame& dst,
+    Buffer& buff, ise_t* env, PlaneProfile* prof)
 {
     const int p[] = { PLANAR_Y, PLANAR_U, PLANAR_V };
+    const int dbytes = vi.ComponentSize();
+    const int numOut = core->numOutputs();
+
+    // the previous results are reused only for sequential access.
+    const bool reuse = (mode & tcm_mode_t::TEMPORAL) && prevSrc
+        && (n == prevN || n == prevN + 1);
+
+    AVSMap* props = nullptr;
+    if (mode & tcm_mode_t::OUTPUT_GRADIENT) {
+        props = env->getFramePropsRW(dst);
+        env->propDeleteKey(props, "TCM_direction");
+        env->propDeleteKey(props, "TCM_dirpitch");
+    }
+    if (chains > 0) {
+        props = env->getFramePropsRW(dst);
+        env->propDeleteKey(props, "TCM_chains");
+        env->propDeleteKey(props, "TCM_chains_dropped");
+    }
+
+    const bool autoth =
+        mode & (tcm_mode_t::AUTO_PERCENTILE | tcm_mode_t::AUTO_OTSU);
+    if (autoth && (mode & tcm_mode_t::AT_LEAST_V8)) {
+        props = env->getFramePropsRW(dst);
+        env->propDeleteKey(props, "TCM_t_l");
+        env->propDeleteKey(props, "TCM_t_h");
+    }
+
+    // windows of roi, mask and skip_flat are copied to a buffer of their own.
+    std::unique_ptr<Buffer> window;
+    PVideoFrame maskFrame;
+    const int lumaWidth = src->GetRowSize(PLANAR_Y) / bytes;
+    const int lumaHeight = src->GetHeight(PLANAR_Y);
+    if (windowSize > 0) {
+        window = std::make_unique<Buffer>(windowSize,
+            (mode & tcm_mode_t::AT_LEAST_V8) != 0, env);
+        if (region.mask) {
+            maskFrame = region.mask->GetFrame(n, env);
+        }
+    }
 
+    PlaneResult res{};
+    res.timing = res.counting = prof != nullptr;
+    // hardware counters are read only for debug, if the system permits.
+    if (prof && (mode & tcm_mode_t::SET_DEBUG_INFO)) {
+        res.perf = get_perf_counters();
+    }
     for (int i = 0; i < numPlanes; ++i) {
         auto plane = p[i];
         auto srcp = src->GetReadPtr(plane);
@@ -107,225 +244,329 @@ void TCannyMod::mainLoop(PVideoFrame& src, PVideoFrame& dst, Buffer& buff,
         auto width = src->GetRowSize(plane) / bytes;
         auto height = src->GetHeight(plane);
         auto dstp = dst->GetWritePtr(plane);
-        auto dpitch = dst->GetPitch(plane) / bytes;
+        auto dpitch = dst->GetPitch(plane) / dbytes;
+        size_t outSize = static_cast<size_t>(dpitch) * dbytes * height;
 
         if (i > 0) {
-            if (mode & mode_t::COPY_CHROMA) {
-                env->BitBlt(dstp, dpitch * bytes, srcp, spitch * bytes,
-                    width * bytes, height);
+            if (mode & tcm_mode_t::COPY_CHROMA) {
+                for (int t = 0; t < numOut; ++t) {
+                    env->BitBlt(dstp + t * outSize, dpitch * bytes, srcp,
+                        spitch * bytes, width * bytes, height);
+                }
                 continue;
-            } else if (mode & mode_t::FILL_HALF_CHROMA) {
+            } else if (mode & tcm_mode_t::FILL_HALF_CHROMA) {
                 uint32_t* d = reinterpret_cast<uint32_t*>(dstp);
-                std::fill_n(d, dpitch * bytes * height / sizeof(uint32_t),
+                std::fill_n(d, outSize * numOut / sizeof(uint32_t),
                     get_halfvalue(bits));
                 continue;
-            } else if (mode & mode_t::FILL_ZERO_CHROMA) {
-                memset(dstp, dpitch * bytes * height, 0);
+            } else if (mode & tcm_mode_t::FILL_ZERO_CHROMA) {
+                memset(dstp, 0, outSize * numOut);
                 continue;
             }
         }
-        if (mode & mode_t::DO_BLUR_ONLY) {
-            gaussianBlur(srcp, spitch, buff.hbuff, hbPitch, dstp, dpitch,
-                width, height, radius, gbweights.data(), maxval);
+        if (mode & tcm_mode_t::DO_NMS_ONLY) {
+            // magnitude comes from the source frame and directions from its
+            // properties, both are read in place.
+            auto map = env->getFramePropsRO(src);
+            int err = 0;
+            auto dirp = env->propGetData(map, "TCM_direction", i, &err);
+            int64_t drpitch = env->propGetInt(map, "TCM_dirpitch", i, &err);
+            // the pitch is checked too, or the kernels would read beyond
+            // the rows.
+            if (err != 0 || drpitch < width || drpitch > INT_MAX
+                    || env->propGetDataSize(map, "TCM_direction", i, &err)
+                    < drpitch * int64_t(sizeof(int32_t)) * height) {
+                env->ThrowError("CannyNMS: source clip has no directions.");
+            }
+            core->suppress(reinterpret_cast<const float*>(srcp), spitch,
+                reinterpret_cast<const int32_t*>(dirp),
+                static_cast<int>(drpitch), reinterpret_cast<float*>(dstp),
+                dpitch, width, height);
             continue;
         }
-        gaussianBlur(srcp, spitch, buff.hbuff, hbPitch, buff.blurp,
-            blPitch, width, height, radius, gbweights.data(), maxval);
-
-        if ((mode & mode_t::CALC_DIRECTION) == 0) {
-            edgeMask(buff.blurp, blPitch, dstp, dpitch, opr, scale,
-                width, height, maxval, nullptr, 0);
+        if (mode & tcm_mode_t::TEMPORAL) {
+            core->processTemporal(srcp, spitch,
+                reuse ? prevSrc->GetReadPtr(plane) : nullptr,
+                reuse ? prevSrc->GetPitch(plane) / bytes : 0,
+                reuse ? prevDst->GetReadPtr(plane) : nullptr,
+                reuse ? prevDst->GetPitch(plane) / dbytes : 0,
+                nmsCache + core->nmsCacheSize() / sizeof(float) * i,
+                dstp, dpitch, width, height, buff.orig);
             continue;
         }
 
-        edgeMask(buff.blurp, blPitch, buff.emaskp, emPitch, opr, scale, width,
-            height, maxval, buff.dirp, dirPitch);
+        if (window) {
+            int ssw = 0, ssh = 0;
+            while ((lumaWidth >> ssw) > width) ++ssw;
+            while ((lumaHeight >> ssh) > height) ++ssh;
+            MaskPlane mp{};
+            if (maskFrame) {
+                mp = { maskFrame->GetReadPtr(), maskFrame->GetPitch(),
+                    region.mask->GetVideoInfo().ComponentSize(), ssw, ssh };
+            }
+            // roi in the coordinates of the plane.
+            Rect roi{};
+            if (!region.roi.empty()) {
+                const auto& r = region.roi;
+                roi.x = r[0] >> ssw;
+                roi.y = r[1] >> ssh;
+                roi.width = std::min(width,
+                    (r[0] + r[2] + (1 << ssw) - 1) >> ssw) - roi.x;
+                roi.height = std::min(height,
+                    (r[1] + r[3] + (1 << ssh) - 1) >> ssh) - roi.y;
+            }
+            core->processRegions(srcp, spitch, dstp, dpitch, width, height,
+                region.roi.empty() ? nullptr : &roi,
+                maskFrame ? &mp : nullptr, region.copy, buff.orig,
+                reinterpret_cast<uint8_t*>(window->orig), &res);
+        } else if (mode & tcm_mode_t::JOINT_COLOR) {
+            const int yuv[] = { PLANAR_Y, PLANAR_U, PLANAR_V };
+            const int rgb[] = { PLANAR_G, PLANAR_B, PLANAR_R };
+            const int* cp = child->GetVideoInfo().IsRGB() ? rgb : yuv;
+            const uint8_t* planes[3];
+            int pitches[3];
+            for (int c = 0; c < 3; ++c) {
+                planes[c] = src->GetReadPtr(cp[c]);
+                pitches[c] = src->GetPitch(cp[c]) / bytes;
+            }
+            core->processColor(planes, pitches, dstp, dpitch, width, height,
+                buff.orig, &res);
+        } else {
+            core->process(srcp, spitch, dstp, dpitch, width, height,
+                buff.orig, &res);
+        }
+        if (prof) {
+            std::copy_n(res.stageNs, NUM_STAGES, prof[i].stageNs);
+            std::fill_n(res.stageNs, NUM_STAGES, 0);
+            prof[i].hyst = res.hyst;
+            res.hyst = {};
+            prof[i].perf = res.perf != nullptr;
+            memcpy(prof[i].perfCounts, res.perfCounts, sizeof(res.perfCounts));
+            memset(res.perfCounts, 0, sizeof(res.perfCounts));
+            prof[i].pixels = static_cast<int64_t>(width) * height;
+        }
 
-        if ((mode & mode_t::SHOW_DIRECTION)) {
-            writeDirections(buff.dirp, dirPitch, dstp, dpitch, width, height);
+        if (mode & tcm_mode_t::OUTPUT_GRADIENT) {
+            env->propSetDataH(props, "TCM_direction",
+                reinterpret_cast<const char*>(res.dirp),
+                static_cast<int>(res.dirPitch * sizeof(int32_t) * height),
+                PROPDATATYPEHINT_BINARY, PROPAPPENDMODE_APPEND);
+            env->propSetInt(props, "TCM_dirpitch", res.dirPitch,
+                PROPAPPENDMODE_APPEND);
             continue;
         }
+        if (autoth && props) {
+            env->propSetFloat(props, "TCM_t_l", res.tl, PROPAPPENDMODE_APPEND);
+            env->propSetFloat(props, "TCM_t_h", res.th, PROPAPPENDMODE_APPEND);
+        }
+        if (chains > 0) {
+            setChains(props, i, res, env);
+        }
+    }
 
-        nonMaximumSuppression(buff.emaskp, emPitch, buff.dirp, dirPitch,
-            buff.blurp, blPitch, width, height);
-
-        hysteresis(dstp, dpitch, buff.blurp, blPitch, width, height, tmin, tmax,
-            maxval);
+    if (mode & tcm_mode_t::TEMPORAL) {
+        prevN = n;
+        prevSrc = src;
+        prevDst = dst;
     }
 }
 
 
-PVideoFrame __stdcall TCannyMod::GetFrame(int n, ise_t* env)
+void TCannyMod::setChains(AVSMap* props, int plane, const PlaneResult& res,
+    ise_t* env)
 {
-    if (mode & mode_t::SET_DEBUG_INFO) {
-        return getFrameDebug(n, env);
+    auto numOut = static_cast<int>(res.chains.size());
+
+    for (int t = 0; t < numOut; ++t) {
+        const auto& ec = res.chains[t];
+        auto idx = plane * numOut + t;
+        env->propSetInt(props, "TCM_chains",
+            static_cast<int64_t>(ec.pixels.size()), PROPAPPENDMODE_APPEND);
+        env->propSetInt(props, "TCM_chains_dropped", ec.dropped,
+            PROPAPPENDMODE_APPEND);
+        env->propSetIntArray(props,
+            ("TCM_chain_pixels_" + std::to_string(idx)).c_str(),
+            ec.pixels.data(), static_cast<int>(ec.pixels.size()));
+        env->propSetIntArray(props,
+            ("TCM_chain_bbox_" + std::to_string(idx)).c_str(),
+            ec.bbox.data(), static_cast<int>(ec.bbox.size()));
+        if (ec.points) {
+            env->propSetIntArray(props,
+                ("TCM_chain_points_" + std::to_string(idx)).c_str(),
+                ec.coords.data(), static_cast<int>(ec.coords.size()));
+        }
     }
-
-    bool isV8 = mode & mode_t::AT_LEAST_V8;
-    Buffer buff(hbSize, blSize, emSize, dirSize, align, hbPad, isV8, env);
-    auto src = child->GetFrame(n, env);
-    auto dst = isV8 ? env->NewVideoFrameP(vi, &src) : env->NewVideoFrame(vi);
-
-    mainLoop(src, dst, buff, env);
-
-    return dst;
 }
 
 
-void TCannyMod::generateWeights(float sigma)
+PVideoFrame __stdcall TCannyMod::GetFrame(int n, ise_t* env)
 {
-    int w = vi.width, h = vi.height;
-    if ((mode & mode_t::PROC_CHROMA) && numPlanes > 1) {
-        if (vi.IsYV411()) w /= 4;
-        if (vi.Is422() || vi.Is420()) w /= 2;
-        if (vi.Is420()) h /= 2;
+    if ((mode & tcm_mode_t::SET_DEBUG_INFO) || stats) {
+        return getFrameTimed(n, env);
     }
 
-    auto t = static_cast<int>(sigma * 3 + 0.5f);
-    radius = std::max(1, t);
-    validate(std::min(w, h) < radius, "sigma is too large");
+    bool isV8 = mode & tcm_mode_t::AT_LEAST_V8;
+    Buffer buff(core->scratchSize(), isV8, env);
+    auto src = child->GetFrame(n, env);
+    auto dst = isV8 ? env->NewVideoFrameP(vi, &src) : env->NewVideoFrame(vi);
 
-    int length = radius * 2 + 1;
-    gbweights.resize(length, 0.0f);
-    dbgweights.resize(length, 0.0);
+    mainLoop(n, src, dst, buff, env);
 
-    float sum = 0.0f;
-    for (int r = -radius; r <= radius; ++r) {
-        float weight = std::exp((-1 * r * r) / (2.0f * sigma * sigma));
-        gbweights[r + radius] = weight;
-        sum += weight;
-    }
-    for (int i = 0; i < length; ++i) {
-        gbweights[i] /= sum;
-        dbgweights[i] = gbweights[i];
-    }
+    return dst;
 }
 
 
-TCannyMod::TCannyMod(PClip c, float _tmin, float _tmax, float _sc,
-    operator_t& _o, float sigma, int _m, arch_t _a) :
-    GenericVideoFilter(c), tmin(_tmin), tmax(_tmax), scale(_sc), opr(_o),
-    mode(_m), arch(_a), radius(0), hbPitch(0), hbPad(0), blPitch(0),
-    emPitch(0), dirPitch(0), hbSize(0), blSize(0), emSize(0), dirSize(0),
-    edgeMask(nullptr), writeDirections(nullptr), hysteresis(nullptr),
-    nonMaximumSuppression(nullptr)
+TCannyMod::TCannyMod(PClip c, const std::vector<float>& _tmin,
+    const std::vector<float>& _tmax, float _sc, operator_t& _o, float sigma,
+    int _m, arch_t _a, int _minlen, int _chains, float _pct, float _ratio,
+    const Region& _region, int _expand, int _inflate, int _maxDistance) :
+    GenericVideoFilter(c), mode(_m), chains(_chains), opt(a2s(_a)),
+    prevN(-1), nmsCache(nullptr), region(_region), windowSize(0)
 {
     validate(!vi.IsPlanar(), "Planar format only.");
     bits = vi.BitsPerComponent();
+    validate((mode & (DO_NMS_ONLY | DO_HYSTERESIS_ONLY)) && bits != 32,
+        "32bit float format only.");
     bytes = (bits + 7) / 8;
-    numPlanes = (vi.IsY() || mode & mode_t::DO_NOT_TOUCH_CHROMA) ? 1 : 3;
-    maxval = bits == 32 ? 1.0f :
-        vi.IsRGB() ? 1.0f * ((1 << bits) - 1) : 1.0f * (0xFF << (bits - 8));
-
-    opt = a2s(arch);
-
-    align = 64;
-    int bm = align - 1;
-
-    if ((mode & mode_t::DO_NOT_BLUR) == 0) {
-        generateWeights(sigma);
-        hbPad = (radius * sizeof(float) + bm) & ~bm;
-        hbPitch = (2 * hbPad + (vi.width * sizeof(float) + bm)) & ~bm;
-        hbSize = hbPitch * (arch == USE_AVX512 ? 6 : 4);
-        hbPitch /= sizeof(float);
+    numPlanes = (vi.IsY() || mode & tcm_mode_t::DO_NOT_TOUCH_CHROMA) ? 1 : 3;
+    if (mode & tcm_mode_t::JOINT_COLOR) {
+        validate(!vi.Is444() && !vi.IsPlanarRGB() && !vi.IsPlanarRGBA(),
+            "color requires YUV 4:4:4 or planar RGB.");
+        numPlanes = 1;
     }
 
-    if (mode & mode_t::DETECT_EDGE) {
-        blPitch = (vi.width * sizeof(float) + bm) & ~bm;
-        blSize = blPitch * vi.height;
-        blPitch /= sizeof(float);
+    CoreParams params{};
+    params.mode = mode;
+    params.arch = _a;
+    params.bits = bits;
+    params.maxval = bits == 32 ? 1.0f :
+        vi.IsRGB() ? 1.0f * ((1 << bits) - 1) : 1.0f * (0xFF << (bits - 8));
+    params.width = params.minWidth = vi.width;
+    params.height = params.minHeight = vi.height;
+    if ((mode & tcm_mode_t::PROC_CHROMA) && numPlanes > 1) {
+        if (vi.IsYV411()) params.minWidth /= 4;
+        if (vi.Is422() || vi.Is420()) params.minWidth /= 2;
+        if (vi.Is420()) params.minHeight /= 2;
     }
-
-    if (mode & mode_t::CALC_DIRECTION) {
-        dirPitch = blPitch;
-        dirSize = blSize;
+    params.sigma = sigma;
+    params.scale = _sc;
+    params.opr = _o;
+    params.tmin = _tmin;
+    params.tmax = _tmax;
+    params.minlen = _minlen;
+    params.chains = _chains;
+    params.percentile = _pct;
+    params.ratio = _ratio;
+    params.expand = _expand;
+    params.inflate = _inflate;
+    params.maxDistance = _maxDistance;
+
+    core = std::make_unique<TCannyCore>(params);
+
+    const auto& weights = core->getWeights();
+    dbgweights.assign(weights.begin(), weights.end());
+
+    if (mode & tcm_mode_t::TEMPORAL) {
+        nmsCache = reinterpret_cast<float*>(
+            avs_malloc(core->nmsCacheSize() * numPlanes, SCRATCH_ALIGN));
+        validate(!nmsCache, "failed to allocate temporal memory.");
     }
 
-    if (mode & GENERATE_CANNY_IMAGE) {
-        emPitch = blPitch;
-        emSize = blSize;
+    if (!region.roi.empty()) {
+        const auto& r = region.roi;
+        validate(r.size() != 4, "roi must be [x, y, width, height].");
+        validate(r[0] < 0 || r[1] < 0 || r[2] < 1 || r[3] < 1
+            || r[0] + r[2] > vi.width || r[1] + r[3] > vi.height,
+            "roi is out of the frame.");
+        mode |= tcm_mode_t::PROCESS_ROI;
+    }
+    if (region.mask) {
+        validate(mode & tcm_mode_t::PROCESS_ROI,
+            "roi and mask cannot be used together.");
+        const auto& mvi = region.mask->GetVideoInfo();
+        validate(!mvi.IsPlanar() || mvi.width != vi.width
+            || mvi.height != vi.height,
+            "mask must be a planar clip of the same size.");
+        mode |= tcm_mode_t::PROCESS_MASK;
+    }
+    if (mode & (tcm_mode_t::PROCESS_ROI | tcm_mode_t::PROCESS_MASK
+            | tcm_mode_t::SKIP_FLAT)) {
+        // a window is at most the whole luma plane.
+        windowSize = (mode & tcm_mode_t::PROCESS_ROI)
+            ? core->windowSize(region.roi[2], region.roi[3])
+            : core->windowSize(vi.width, vi.height);
     }
 
-    gaussianBlur = get_gblur(bytes, arch, radius, mode);
-
-    edgeMask = get_emask(bytes, arch, mode);
-
-    writeDirections = get_write_dir(bytes);
-
-    nonMaximumSuppression = get_nms(arch);
+    auto statsPath = get_stats_path();
+    if (!statsPath.empty()) {
+        stats = std::make_unique<StatsCollector>(statsPath);
+        stats->setInfo("opt", opt);
+        stats->setInfo("mode", mode);
+        stats->setInfo("bits", bits);
+        stats->setInfo("width", vi.width);
+        stats->setInfo("height", vi.height);
+        stats->setInfo("planes", numPlanes);
+        stats->setInfo("radius", core->getRadius());
+        stats->setInfo("outputs", core->numOutputs());
+    }
 
-    hysteresis = get_hysteresis(bytes);
+    // each pair of thresholds yields its own edge map, stacked vertically.
+    vi.height *= core->numOutputs();
+
+    // the edges of the three planes are output as a single plane.
+    if (mode & tcm_mode_t::JOINT_COLOR) {
+        switch (bits) {
+        case 8: vi.pixel_type = VideoInfo::CS_Y8; break;
+        case 10: vi.pixel_type = VideoInfo::CS_Y10; break;
+        case 12: vi.pixel_type = VideoInfo::CS_Y12; break;
+        case 14: vi.pixel_type = VideoInfo::CS_Y14; break;
+        case 16: vi.pixel_type = VideoInfo::CS_Y16; break;
+        default: vi.pixel_type = VideoInfo::CS_Y32;
+        }
+    }
 
+    // gradient magnitude is passed to the following stages as float.
+    if (mode & tcm_mode_t::OUTPUT_GRADIENT) {
+        vi.pixel_type = (vi.pixel_type & ~VideoInfo::CS_Sample_Bits_Mask)
+            | VideoInfo::CS_Sample_Bits_32;
+    }
 }
 
 
 static void set_chroma_mode(int chroma, int& mode)
 {
-    int ret = 0;
     switch (chroma) {
-    case 0: mode |= mode_t::DO_NOT_TOUCH_CHROMA; return;
-    case 1: mode |= mode_t::PROC_CHROMA; return;
-    case 2: mode |= mode_t::COPY_CHROMA; return;
-    case 3: mode |= mode_t::FILL_HALF_CHROMA; return;
-    case 4: mode |= mode_t::FILL_ZERO_CHROMA; return;
+    case 0: mode |= tcm_mode_t::DO_NOT_TOUCH_CHROMA; return;
+    case 1: mode |= tcm_mode_t::PROC_CHROMA; return;
+    case 2: mode |= tcm_mode_t::COPY_CHROMA; return;
+    case 3: mode |= tcm_mode_t::FILL_HALF_CHROMA; return;
+    case 4: mode |= tcm_mode_t::FILL_ZERO_CHROMA; return;
     }
 }
 
 
-arch_t get_arch(int opt)
+static std::vector<float> get_threshold(const AVSValue& arg, float def)
 {
-    if (opt == 0) {
-        return arch_t::NO_SIMD;
-    }
-    if (opt == 1) {
-        if (has_sse41()) return arch_t::USE_SSE4;
-        return arch_t::NO_SIMD;
-    }
-    if (opt == 2) {
-        if (has_avx2()) return arch_t::USE_AVX2;
-        if (has_sse41()) return arch_t::USE_SSE4;
-        return arch_t::NO_SIMD;
-    }
-    if (has_avx512()) return arch_t::USE_AVX512;
-    if (has_avx2()) return arch_t::USE_AVX2;
-    if (has_sse41()) return arch_t::USE_SSE4;
-    return arch_t::NO_SIMD;
+    if (!arg.Defined()) {
+        return std::vector<float>{ def };
+    }
+    if (!arg.IsArray()) {
+        return std::vector<float>{ static_cast<float>(arg.AsFloat()) };
+    }
+    std::vector<float> t(arg.ArraySize());
+    for (int i = 0; i < arg.ArraySize(); ++i) {
+        t[i] = static_cast<float>(arg[i].AsFloat());
+    }
+    return t;
 }
 
 
-static operator_t parse_operator(const char* o, int& mode)
+static void get_thresholds(const AVSValue& l, const AVSValue& h,
+    std::vector<float>& tmin, std::vector<float>& tmax)
 {
-    std::string ostring(o);
-    if (ostring == "standard") {
-        mode |= mode_t::USE_STANDARD_OPERATOR;
-        return operator_t{ 0.0f, 1.0f, 0.0f };
-    } else if (ostring == "sobel") {
-        mode |= mode_t::USE_SOBEL_OPERATOR;
-        return operator_t{ 1.0f, 2.0f, 1.0f };
-    } else if (ostring == "prewitt") {
-        mode |= mode_t::USE_CUSTOM_OPERATOR;
-        return operator_t{ 1.0f, 1.0f, 1.0f };
-    }
-
-    try {
-        auto v = split(ostring, " ");
-        validate(v.size() != 3, nullptr);
-
-        operator_t opr;
-        opr[0] = std::stof(v[0]);
-        opr[1] = std::stof(v[1]);
-        opr[2] = std::stof(v[2]);
-        if (opr[0] == 0.0f && opr[1] == 1.0f && opr[2] == 0.0f) {
-            mode |= mode_t::USE_STANDARD_OPERATOR;
-        } else if (opr[0] == 1.0f && opr[1] == 2.0f && opr[2] == 1.0f) {
-            mode |= mode_t::USE_SOBEL_OPERATOR;
-        } else {
-            mode |= mode_t::USE_CUSTOM_OPERATOR;
-        }
-        return opr;
-    } catch (std::exception&) {
-        throw std::runtime_error("invalid operator is set.");
-    }
+    tmin = get_threshold(l, 1.0f);
+    tmax = get_threshold(h, 8.0f);
+    check_thresholds(tmin, tmax);
 }
 
 
@@ -333,9 +574,9 @@ static AVSValue __cdecl
 create_gblur(AVSValue args, void* user_data, ise_t* env)
 {
     try {
-        int mode = mode_t::DO_BLUR_ONLY;
+        int mode = tcm_mode_t::DO_BLUR_ONLY;
         if (user_data != nullptr) {
-            mode |= mode_t::AT_LEAST_V8;
+            mode |= tcm_mode_t::AT_LEAST_V8;
         }
 
         auto clip = args[0].AsClip();
@@ -350,12 +591,13 @@ create_gblur(AVSValue args, void* user_data, ise_t* env)
         auto arch = get_arch(args[3].AsInt(-1));
 
         if (args[4].AsBool(false) && user_data != nullptr) {
-            mode |= mode_t::SET_DEBUG_INFO;
+            mode |= tcm_mode_t::SET_DEBUG_INFO;
         }
 
         operator_t o = parse_operator("standard", mode);
 
-        return new TCannyMod(clip, 0.0f, 0.0f, 1.0f, o, sigma, mode, arch);
+        return new TCannyMod(clip, { 0.0f }, { 0.0f }, 1.0f, o, sigma, mode,
+            arch);
 
     } catch (std::exception& e) {
         env->ThrowError("GBlur2: %s", e.what());
@@ -368,9 +610,9 @@ static AVSValue __cdecl
 create_emask(AVSValue args, void* user_data, ise_t* env)
 {
     try {
-        int mode = mode_t::DETECT_EDGE;
+        int mode = tcm_mode_t::DETECT_EDGE;
         if (user_data != nullptr) {
-            mode |= mode_t::AT_LEAST_V8;
+            mode |= tcm_mode_t::AT_LEAST_V8;
         }
 
         auto clip = args[0].AsClip();
@@ -380,17 +622,17 @@ create_emask(AVSValue args, void* user_data, ise_t* env)
         float scale = static_cast<float>(args[2].AsFloat(5.1));
         validate(scale <= 0.0f, "scale must be greater than zero.");
         if (scale != 1.0f) {
-            mode |= mode_t::SCALE_MAGNITUDE;
+            mode |= tcm_mode_t::SCALE_MAGNITUDE;
         }
 
         float sigma = static_cast<float>(args[3].AsFloat(0.50));
         validate(sigma < 0.0f, "sigma must be greater than or equal to zero.");
         if (sigma == 0.0f) {
-            mode |= mode_t::DO_NOT_BLUR;
+            mode |= tcm_mode_t::DO_NOT_BLUR;
         }
 
         if (args[4].AsBool(false)) {
-            mode |= mode_t::STRICT_MAGNITUDE;
+            mode |= tcm_mode_t::STRICT_MAGNITUDE;
         }
 
         auto chroma = args[5].AsInt(0);
@@ -400,10 +642,15 @@ create_emask(AVSValue args, void* user_data, ise_t* env)
         auto arch = get_arch(args[6].AsInt(-1));
 
         if (args[7].AsBool(false) && user_data != nullptr) {
-            mode |= mode_t::SET_DEBUG_INFO;
+            mode |= tcm_mode_t::SET_DEBUG_INFO;
+        }
+
+        if (args[8].AsBool(false)) {
+            mode |= tcm_mode_t::SKIP_FLAT;
         }
 
-        return new TCannyMod(clip, 0, 0, scale, opr, sigma, mode, arch);
+        return new TCannyMod(clip, { 0.0f }, { 0.0f }, scale, opr, sigma, mode,
+            arch);
 
     } catch (std::exception& e) {
         env->ThrowError("EMask: %s", e.what());
@@ -416,11 +663,11 @@ static AVSValue __cdecl
 create_dirmap(AVSValue args, void* user_data, ise_t* env)
 {
     try {
-        int mode = mode_t::DETECT_EDGE | mode_t::CALC_DIRECTION
-            | mode_t::SHOW_DIRECTION;
+        int mode = tcm_mode_t::DETECT_EDGE | tcm_mode_t::CALC_DIRECTION
+            | tcm_mode_t::SHOW_DIRECTION;
 
         if (user_data != nullptr) {
-            mode |= mode_t::AT_LEAST_V8;
+            mode |= tcm_mode_t::AT_LEAST_V8;
         }
 
         auto clip = args[0].AsClip();
@@ -430,7 +677,7 @@ create_dirmap(AVSValue args, void* user_data, ise_t* env)
         float sigma = static_cast<float>(args[2].AsFloat(1.50));
         validate(sigma < 0.0f, "sigma must be greater than or equal to zero.");
         if (sigma == 0.0f) {
-            mode |= mode_t::DO_NOT_BLUR;
+            mode |= tcm_mode_t::DO_NOT_BLUR;
         }
 
         auto chroma = args[3].AsInt(0);
@@ -440,10 +687,11 @@ create_dirmap(AVSValue args, void* user_data, ise_t* env)
         auto arch = get_arch(args[4].AsInt(-1));
 
         if (args[5].AsBool(false) && user_data != nullptr) {
-            mode |= mode_t::SET_DEBUG_INFO;
+            mode |= tcm_mode_t::SET_DEBUG_INFO;
         }
 
-        return new TCannyMod(clip, 0, 0, 1.0f, opr, sigma, mode, arch);
+        return new TCannyMod(clip, { 0.0f }, { 0.0f }, 1.0f, opr, sigma, mode,
+            arch);
 
     } catch (std::exception& e) {
         env->ThrowError("DirMap: %s", e.what());
@@ -453,40 +701,89 @@ create_dirmap(AVSValue args, void* user_data, ise_t* env)
 
 
 static AVSValue __cdecl
-create_canny(AVSValue args, void* user_data, ise_t* env)
+create_distmap(AVSValue args, void* user_data, ise_t* env)
 {
     try {
-        int mode = mode_t::DETECT_EDGE | mode_t::CALC_DIRECTION
-            | mode_t::GENERATE_CANNY_IMAGE;
+        int mode = tcm_mode_t::DETECT_EDGE | tcm_mode_t::CALC_DIRECTION
+            | tcm_mode_t::GENERATE_CANNY_IMAGE | tcm_mode_t::DISTANCE_MAP;
 
         if (user_data != nullptr) {
-            mode |= mode_t::AT_LEAST_V8;
+            mode |= tcm_mode_t::AT_LEAST_V8;
         }
 
         auto clip = args[0].AsClip();
 
-        auto tmin = static_cast<float>(args[1].AsFloat(1.0));
-        validate(tmin <= 0.0f, "t_l must be greater than 0.");
+        std::vector<float> tmin, tmax;
+        get_thresholds(args[1], args[2], tmin, tmax);
 
-        auto tmax = static_cast<float>(args[2].AsFloat(8.0));
-        validate(tmax <= tmin, "t_h must be greater than t_l.");
+        auto radius = args[3].AsInt(16);
+        validate(radius < 1 || radius > DISTANCE_MAX,
+            "radius must be 1 to 1024.");
+
+        auto opr = parse_operator(args[4].AsString("standard"), mode);
+
+        float sigma = static_cast<float>(args[5].AsFloat(1.50));
+        validate(sigma < 0.0f, "sigma must be greater than or equal to zero.");
+        if (sigma == 0.0f) {
+            mode |= tcm_mode_t::DO_NOT_BLUR;
+        }
+
+        if (args[6].AsBool(true)) {
+            mode |= tcm_mode_t::STRICT_MAGNITUDE;
+        }
+
+        auto chroma = args[7].AsInt(0);
+        validate(chroma < 0 || chroma > 4, "chroma must be 0, 1, 2, 3 or 4");
+        set_chroma_mode(chroma, mode);
+
+        auto arch = get_arch(args[8].AsInt(-1));
+
+        if (args[9].AsBool(false) && user_data != nullptr) {
+            mode |= tcm_mode_t::SET_DEBUG_INFO;
+        }
+
+        return new TCannyMod(clip, tmin, tmax, 1.0f, opr, sigma, mode, arch,
+            0, 0, 80.0f, 0.4f, {}, 0, 0, radius);
+
+    } catch (std::exception& e) {
+        env->ThrowError("DistMap: %s", e.what());
+    }
+    return 0;
+}
+
+
+static AVSValue __cdecl
+create_canny(AVSValue args, void* user_data, ise_t* env)
+{
+    try {
+        int mode = tcm_mode_t::DETECT_EDGE | tcm_mode_t::CALC_DIRECTION
+            | tcm_mode_t::GENERATE_CANNY_IMAGE;
+
+        if (user_data != nullptr) {
+            mode |= tcm_mode_t::AT_LEAST_V8;
+        }
+
+        auto clip = args[0].AsClip();
+
+        std::vector<float> tmin, tmax;
+        get_thresholds(args[1], args[2], tmin, tmax);
 
         auto opr = parse_operator(args[3].AsString("standard"), mode);
 
         float scale = static_cast<float>(args[4].AsFloat(1.0));
         validate(scale <= 0.0f, "scale must be greater than zero.");
         if (scale != 1.0f) {
-            mode |= mode_t::SCALE_MAGNITUDE;
+            mode |= tcm_mode_t::SCALE_MAGNITUDE;
         }
 
         float sigma = static_cast<float>(args[5].AsFloat(1.50));
         validate(sigma < 0.0f, "sigma must be greater than or equal to zero.");
         if (sigma == 0.0f) {
-            mode |= mode_t::DO_NOT_BLUR;
+            mode |= tcm_mode_t::DO_NOT_BLUR;
         }
 
         if (args[6].AsBool(true)) {
-            mode |= mode_t::STRICT_MAGNITUDE;
+            mode |= tcm_mode_t::STRICT_MAGNITUDE;
         }
 
         auto chroma = args[7].AsInt(0);
@@ -496,10 +793,97 @@ create_canny(AVSValue args, void* user_data, ise_t* env)
         auto arch = get_arch(args[8].AsInt(-1));
 
         if (args[9].AsBool(false) && user_data != nullptr) {
-            mode |= mode_t::SET_DEBUG_INFO;
+            mode |= tcm_mode_t::SET_DEBUG_INFO;
         }
 
-        return new TCannyMod(clip, tmin, tmax, scale, opr, sigma, mode, arch);
+        auto minlen = args[10].AsInt(0);
+        validate(minlen < 0, "minlen must be greater than or equal to 0.");
+
+        auto chains = args[11].AsInt(0);
+        validate(chains < 0 || chains > 2, "chains must be 0, 1 or 2.");
+        validate(chains > 0 && user_data == nullptr,
+            "chains requires AviSynth+ 3.7.3 or later.");
+
+        if (args[12].AsBool(false)) {
+            validate(minlen > 0 || chains > 0,
+                "temporal cannot be used with minlen or chains.");
+            mode |= tcm_mode_t::TEMPORAL;
+        }
+
+        auto autoth = args[13].AsInt(0);
+        validate(autoth < 0 || autoth > 2, "auto_threshold must be 0, 1 or 2.");
+        if (autoth > 0) {
+            validate(tmin.size() > 1,
+                "auto_threshold cannot be used with arrays of t_l/t_h.");
+            validate(mode & tcm_mode_t::TEMPORAL,
+                "auto_threshold cannot be used with temporal.");
+            mode |= autoth == 1 ? tcm_mode_t::AUTO_PERCENTILE : tcm_mode_t::AUTO_OTSU;
+        }
+
+        float pct = static_cast<float>(args[14].AsFloat(80.0f));
+        validate(pct <= 0.0f || pct >= 100.0f,
+            "percentile must be between 0 and 100.");
+
+        float ratio = static_cast<float>(args[15].AsFloat(0.4f));
+        validate(ratio <= 0.0f || ratio >= 1.0f,
+            "ratio must be between 0 and 1.");
+
+        Region region{};
+        if (args[16].Defined()) {
+            for (int i = 0; i < args[16].ArraySize(); ++i) {
+                region.roi.push_back(args[16][i].AsInt());
+            }
+        }
+        if (args[17].Defined()) {
+            region.mask = args[17].AsClip();
+        }
+        region.copy = args[18].AsBool(false);
+        validate(region.copy && region.roi.empty() && !region.mask,
+            "roi_copy requires roi or mask.");
+        if (!region.roi.empty() || region.mask) {
+            validate(mode & tcm_mode_t::TEMPORAL,
+                "roi and mask cannot be used with temporal.");
+            validate(chains > 0, "roi and mask cannot be used with chains.");
+            validate(region.mask && autoth > 0,
+                "mask cannot be used with auto_threshold.");
+        }
+
+        if (args[19].AsBool(false)) {
+            validate(mode & tcm_mode_t::TEMPORAL,
+                "skip_flat cannot be used with temporal.");
+            validate(autoth > 0,
+                "skip_flat cannot be used with auto_threshold.");
+            validate(chains > 0, "skip_flat cannot be used with chains.");
+            validate(!region.roi.empty() || region.mask,
+                "skip_flat cannot be used with roi or mask.");
+            mode |= tcm_mode_t::SKIP_FLAT;
+        }
+
+        if (args[20].AsBool(false)) {
+            validate(mode & tcm_mode_t::TEMPORAL,
+                "color cannot be used with temporal.");
+            validate(!region.roi.empty() || region.mask,
+                "color cannot be used with roi or mask.");
+            validate(mode & tcm_mode_t::SKIP_FLAT,
+                "color cannot be used with skip_flat.");
+            mode |= tcm_mode_t::JOINT_COLOR;
+        }
+
+        // the output outside of the edge map of the whole plane would not be
+        // the same as expanding it afterwards.
+        auto expand = args[21].AsInt(0);
+        auto inflate = args[22].AsInt(0);
+        if (expand > 0 || inflate > 0) {
+            validate(mode & tcm_mode_t::TEMPORAL,
+                "expand and inflate cannot be used with temporal.");
+            validate(!region.roi.empty() || region.mask,
+                "expand and inflate cannot be used with roi or mask.");
+            validate(mode & tcm_mode_t::SKIP_FLAT,
+                "expand and inflate cannot be used with skip_flat.");
+        }
+
+        return new TCannyMod(clip, tmin, tmax, scale, opr, sigma, mode, arch,
+            minlen, chains, pct, ratio, region, expand, inflate);
 
     } catch (std::exception& e) {
         env->ThrowError("TCannyMod: %s", e.what());
@@ -508,9 +892,125 @@ create_canny(AVSValue args, void* user_data, ise_t* env)
 }
 
 
+static AVSValue __cdecl
+create_gradient(AVSValue args, void* user_data, ise_t* env)
+{
+    try {
+        validate(user_data == nullptr, "AviSynth+ 3.7.3 or later is required.");
+
+        int mode = tcm_mode_t::DETECT_EDGE | tcm_mode_t::CALC_DIRECTION
+            | tcm_mode_t::OUTPUT_GRADIENT | tcm_mode_t::AT_LEAST_V8;
+
+        auto clip = args[0].AsClip();
+
+        auto opr = parse_operator(args[1].AsString("standard"), mode);
+
+        float scale = static_cast<float>(args[2].AsFloat(1.0));
+        validate(scale <= 0.0f, "scale must be greater than zero.");
+        if (scale != 1.0f) {
+            mode |= tcm_mode_t::SCALE_MAGNITUDE;
+        }
+
+        float sigma = static_cast<float>(args[3].AsFloat(1.50));
+        validate(sigma < 0.0f, "sigma must be greater than or equal to zero.");
+        if (sigma == 0.0f) {
+            mode |= tcm_mode_t::DO_NOT_BLUR;
+        }
+
+        if (args[4].AsBool(true)) {
+            mode |= tcm_mode_t::STRICT_MAGNITUDE;
+        }
+
+        auto chroma = args[5].AsInt(0);
+        validate(chroma < 0 || chroma > 1, "chroma must be 0 or 1");
+        set_chroma_mode(chroma, mode);
+
+        auto arch = get_arch(args[6].AsInt(-1));
+
+        return new TCannyMod(clip, { 0.0f }, { 0.0f }, scale, opr, sigma, mode,
+            arch);
+
+    } catch (std::exception& e) {
+        env->ThrowError("CannyGradient: %s", e.what());
+    }
+    return 0;
+}
+
+
+static AVSValue __cdecl
+create_nms(AVSValue args, void* user_data, ise_t* env)
+{
+    try {
+        validate(user_data == nullptr, "AviSynth+ 3.7.3 or later is required.");
+
+        int mode = tcm_mode_t::DO_NMS_ONLY | tcm_mode_t::DO_NOT_BLUR
+            | tcm_mode_t::AT_LEAST_V8;
+
+        auto clip = args[0].AsClip();
+
+        auto chroma = args[1].AsInt(0);
+        validate(chroma < 0 || chroma > 1, "chroma must be 0 or 1");
+        set_chroma_mode(chroma, mode);
+
+        auto arch = get_arch(args[2].AsInt(-1));
+
+        operator_t o = parse_operator("standard", mode);
+
+        return new TCannyMod(clip, { 0.0f }, { 0.0f }, 1.0f, o, 0.0f, mode,
+            arch);
+
+    } catch (std::exception& e) {
+        env->ThrowError("CannyNMS: %s", e.what());
+    }
+    return 0;
+}
+
+
+static AVSValue __cdecl
+create_hysteresis(AVSValue args, void* user_data, ise_t* env)
+{
+    try {
+        validate(user_data == nullptr, "AviSynth+ 3.7.3 or later is required.");
+
+        int mode = tcm_mode_t::DO_HYSTERESIS_ONLY | tcm_mode_t::DO_NOT_BLUR
+            | tcm_mode_t::AT_LEAST_V8;
+
+        auto clip = args[0].AsClip();
+
+        std::vector<float> tmin, tmax;
+        get_thresholds(args[1], args[2], tmin, tmax);
+
+        auto chroma = args[3].AsInt(0);
+        validate(chroma < 0 || chroma > 1, "chroma must be 0 or 1");
+        set_chroma_mode(chroma, mode);
+
+        auto minlen = args[4].AsInt(0);
+        validate(minlen < 0, "minlen must be greater than or equal to 0.");
+
+        auto chains = args[5].AsInt(0);
+        validate(chains < 0 || chains > 2, "chains must be 0, 1 or 2.");
+
+        operator_t o = parse_operator("standard", mode);
+
+        return new TCannyMod(clip, tmin, tmax, 1.0f, o, 0.0f, mode,
+            arch_t::NO_SIMD, minlen, chains);
+
+    } catch (std::exception& e) {
+        env->ThrowError("CannyHysteresis: %s", e.what());
+    }
+    return 0;
+}
+
+
+#if defined(_WIN32)
+#define TCM_EXPORT extern "C" __declspec(dllexport)
+#else
+#define TCM_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
 static const AVS_Linkage* AVS_linkage = nullptr;
 
-extern "C" __declspec(dllexport) const char* __stdcall
+TCM_EXPORT const char* __stdcall
 AvisynthPluginInit3(ise_t* env, const AVS_Linkage* const vectors)
 {
     AVS_linkage = vectors;
@@ -538,7 +1038,8 @@ AvisynthPluginInit3(ise_t* env, const AVS_Linkage* const vectors)
         /*4*/   "[strict]b"
         /*5*/   "[chroma]i"
         /*6*/   "[opt]i"
-        /*7*/   "[debug]b", create_emask, isV8 ? &isV8 : nullptr);
+        /*7*/   "[debug]b"
+        /*8*/   "[skip_flat]b", create_emask, isV8 ? &isV8 : nullptr);
 
     env->AddFunction("DirMap",
         /*0*/   "c"
@@ -548,17 +1049,64 @@ AvisynthPluginInit3(ise_t* env, const AVS_Linkage* const vectors)
         /*4*/   "[opt]i"
         /*5*/   "[debug]b", create_dirmap, isV8 ? &isV8 : nullptr);
 
+    env->AddFunction("DistMap",
+        /*0*/   "c"
+        /*1*/   "[t_l]f*"
+        /*2*/   "[t_h]f*"
+        /*3*/   "[radius]i"
+        /*4*/   "[operator]s"
+        /*5*/   "[sigma]f"
+        /*6*/   "[strict]b"
+        /*7*/   "[chroma]i"
+        /*8*/   "[opt]i"
+        /*9*/   "[debug]b", create_distmap, isV8 ? &isV8 : nullptr);
+
     env->AddFunction("TCannyMod",
         /*0*/   "c"
-        /*1*/   "[t_l]f"
-        /*2*/   "[t_h]f"
+        /*1*/   "[t_l]f*"
+        /*2*/   "[t_h]f*"
         /*3*/   "[operator]s"
         /*4*/   "[scale]f"
         /*5*/   "[sigma]f"
         /*6*/   "[strict]b"
         /*7*/   "[chroma]i"
         /*8*/   "[opt]i"
-        /*9*/   "[debug]b", create_canny, isV8 ? &isV8 : nullptr);
+        /*9*/   "[debug]b"
+        /*10*/  "[minlen]i"
+        /*11*/  "[chains]i"
+        /*12*/  "[temporal]b"
+        /*13*/  "[auto_threshold]i"
+        /*14*/  "[percentile]f"
+        /*15*/  "[ratio]f"
+        /*16*/  "[roi]i*"
+        /*17*/  "[mask]c"
+        /*18*/  "[roi_copy]b"
+        /*19*/  "[skip_flat]b"
+        /*20*/  "[color]b"
+        /*21*/  "[expand]i"
+        /*22*/  "[inflate]i", create_canny, isV8 ? &isV8 : nullptr);
+
+    env->AddFunction("CannyGradient",
+        /*0*/   "c"
+        /*1*/   "[operator]s"
+        /*2*/   "[scale]f"
+        /*3*/   "[sigma]f"
+        /*4*/   "[strict]b"
+        /*5*/   "[chroma]i"
+        /*6*/   "[opt]i", create_gradient, isV8 ? &isV8 : nullptr);
+
+    env->AddFunction("CannyNMS",
+        /*0*/   "c"
+        /*1*/   "[chroma]i"
+        /*2*/   "[opt]i", create_nms, isV8 ? &isV8 : nullptr);
+
+    env->AddFunction("CannyHysteresis",
+        /*0*/   "c"
+        /*1*/   "[t_l]f*"
+        /*2*/   "[t_h]f*"
+        /*3*/   "[chroma]i"
+        /*4*/   "[minlen]i"
+        /*5*/   "[chains]i", create_hysteresis, isV8 ? &isV8 : nullptr);
 
     return "Canny Edge Detection Filter for avisynth+ ver." TCANNY_M_VERSION;
 }
@@ -25,6 +25,11 @@
 #else
     #include <cpuid.h>
 #endif
+#if defined(__linux__)
+    #include <sys/mman.h>
+#endif
+#include <algorithm>
+#include <atomic>
 #include "utils.hpp"
 
 
@@ -78,6 +83,19 @@ static inline void get_cpuid2(int *array, int info_type, int ecx)
 #endif
 }
 
+// XCR0 tells which register states the OS saves on context switches.
+// it must not be read unless cpuid reports OSXSAVE.
+static inline uint64_t get_xcr0() noexcept
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
 static inline int is_bit_set(int bitfield, int bit)  noexcept
 {
     return bitfield & (1 << bit);
@@ -86,6 +104,7 @@ static inline int is_bit_set(int bitfield, int bit)  noexcept
 static uint32_t get_simd_support_info(void) noexcept
 {
     uint32_t ret = 0;
+    uint64_t xcr0 = 0;
     int regs[4] = {0};
 
     get_cpuid(regs, 0x00000001);
@@ -105,7 +124,9 @@ static uint32_t get_simd_support_info(void) noexcept
         ret |= CPU_SSE4_2_SUPPORT;
     }
     if (is_bit_set(regs[2], 27)) {
-        if (is_bit_set(regs[2], 28)) {
+        xcr0 = get_xcr0();
+        // XMM and YMM
+        if (is_bit_set(regs[2], 28) && (xcr0 & 0x06) == 0x06) {
             ret |= CPU_AVX_SUPPORT;
         }
         if (is_bit_set(regs[2], 12)) {
@@ -131,7 +152,8 @@ static uint32_t get_simd_support_info(void) noexcept
     if (is_bit_set(regs[1], 5)) {
         ret |= CPU_AVX2_SUPPORT;
     }
-    if (!is_bit_set(regs[1], 16)) {
+    // XMM, YMM, opmask and ZMM
+    if (!is_bit_set(regs[1], 16) || (xcr0 & 0xE6) != 0xE6) {
         return ret;
     }
     else {
@@ -219,7 +241,8 @@ bool has_avx512(uint32_t info) noexcept
     if (!has_avx2(info)) return false;
 
     auto requirements
-        = CPU_AVX512F_SUPPORT | CPU_AVX512VL_SUPPORT | CPU_AVX512BW_SUPPORT;
+        = CPU_AVX512F_SUPPORT | CPU_AVX512VL_SUPPORT | CPU_AVX512BW_SUPPORT
+        | CPU_AVX512DQ_SUPPORT;
 
     return (info & requirements) == requirements;
 }
@@ -235,6 +258,40 @@ bool has_avx512fp16(uint32_t info) noexcept
 }
 
 
+// walks the deterministic cache parameters of cpuid (leaf 4 on Intel,
+// leaf 0x8000001D on AMD) and returns the largest data or unified cache.
+size_t get_llc_size() noexcept
+{
+    int regs[4] = { 0 };
+    size_t size = 0;
+    for (int leaf : { 0x00000004, static_cast<int>(0x8000001D) }) {
+        get_cpuid(regs, leaf & 0x80000000);
+        if (static_cast<uint32_t>(regs[0]) < static_cast<uint32_t>(leaf)) {
+            continue;
+        }
+        for (int i = 0; i < 16; ++i) {
+            get_cpuid2(regs, leaf, i);
+            int type = regs[0] & 0x1F;
+            if (type == 0) {
+                break;
+            }
+            if (type == 2) { // instruction cache
+                continue;
+            }
+            size_t ways = ((regs[1] >> 22) & 0x3FF) + 1;
+            size_t partitions = ((regs[1] >> 12) & 0x3FF) + 1;
+            size_t line = (regs[1] & 0xFFF) + 1;
+            size_t sets = static_cast<uint32_t>(regs[2]) + size_t(1);
+            size = std::max(size, ways * partitions * line * sets);
+        }
+        if (size > 0) {
+            break;
+        }
+    }
+    return size;
+}
+
+
 std::vector<std::string>
 split(const std::string& str, const char* separator) noexcept
 {
@@ -278,3 +335,230 @@ uint32_t get_halfvalue(int bits)
 }
 
 
+size_t plan_pitch(size_t rowsize, size_t align) noexcept
+{
+    return (rowsize + align - 1) / align * align;
+}
+
+
+static inline bool is_live_together(const ScratchRegion& a,
+    const ScratchRegion& b) noexcept
+{
+    return a.size > 0 && b.size > 0 && a.first <= b.last && b.first <= a.last;
+}
+
+
+size_t plan_scratch(std::vector<ScratchRegion>& regions, size_t align)
+{
+    std::vector<size_t> order(regions.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    // larger regions first, as the greedy placement packs them better.
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return regions[a].size > regions[b].size;
+    });
+
+    size_t total = 0;
+    std::vector<size_t> placed;
+    for (auto i : order) {
+        auto& r = regions[i];
+        r.offset = 0;
+        if (r.size == 0) {
+            continue;
+        }
+        // the lowest offset that does not hit any live placed region.
+        std::vector<std::pair<size_t, size_t>> busy;
+        for (auto j : placed) {
+            if (is_live_together(r, regions[j])) {
+                busy.emplace_back(regions[j].offset,
+                    regions[j].offset + regions[j].size);
+            }
+        }
+        std::sort(busy.begin(), busy.end());
+        for (const auto& b : busy) {
+            if (r.offset + r.size <= b.first) {
+                break;
+            }
+            r.offset = std::max(r.offset, (b.second + align - 1) / align * align);
+        }
+        placed.push_back(i);
+        total = std::max(total, r.offset + r.size);
+    }
+    return total;
+}
+
+
+bool scratch_overlaps(const std::vector<ScratchRegion>& regions) noexcept
+{
+    for (size_t i = 0; i < regions.size(); ++i) {
+        for (size_t j = i + 1; j < regions.size(); ++j) {
+            const auto& a = regions[i];
+            const auto& b = regions[j];
+            if (is_live_together(a, b) && a.offset < b.offset + b.size
+                && b.offset < a.offset + a.size) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+static std::atomic<int64_t> scratch_counts[NUM_SCRATCH_PATHS];
+
+
+void count_scratch(scratch_path_t path) noexcept
+{
+    scratch_counts[path].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+int64_t get_scratch_count(scratch_path_t path) noexcept
+{
+    return scratch_counts[path].load(std::memory_order_relaxed);
+}
+
+
+#if defined(__linux__)
+
+constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+// a few mappings are kept per thread, as a filter chain can hold the
+// buffers of several frames on the same thread at once.
+class ScratchPool {
+    struct Block {
+        uint8_t* ptr;
+        size_t size;
+        scratch_path_t path;
+        bool busy;
+    };
+    static constexpr size_t MAX_BLOCKS = 4;
+    std::vector<Block> blocks;
+
+    static uint8_t* map_hugetlb(size_t size) noexcept
+    {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        return p == MAP_FAILED ? nullptr : reinterpret_cast<uint8_t*>(p);
+    }
+
+    static uint8_t* map_thp(size_t size) noexcept
+    {
+        // over-allocate to align the mapping to the huge page boundary.
+        size_t len = size + HUGE_PAGE_SIZE;
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            return nullptr;
+        }
+        auto orig = reinterpret_cast<uintptr_t>(p);
+        auto aligned = (orig + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        if (aligned > orig) {
+            munmap(p, aligned - orig);
+        }
+        if (aligned + size < orig + len) {
+            munmap(reinterpret_cast<void*>(aligned + size),
+                orig + len - aligned - size);
+        }
+        p = reinterpret_cast<void*>(aligned);
+        if (madvise(p, size, MADV_HUGEPAGE) != 0) {
+            munmap(p, size);
+            return nullptr;
+        }
+        return reinterpret_cast<uint8_t*>(p);
+    }
+
+public:
+    ~ScratchPool()
+    {
+        for (auto& b : blocks) {
+            munmap(b.ptr, b.size);
+        }
+    }
+
+    void* acquire(size_t size) noexcept
+    {
+        for (auto& b : blocks) {
+            if (!b.busy && b.size >= size) {
+                b.busy = true;
+                count_scratch(b.path);
+                return b.ptr;
+            }
+        }
+        if (blocks.size() == MAX_BLOCKS) {
+            auto it = std::find_if(blocks.begin(), blocks.end(),
+                [](const Block& b) { return !b.busy; });
+            if (it == blocks.end()) {
+                return nullptr;
+            }
+            munmap(it->ptr, it->size);
+            blocks.erase(it);
+        }
+
+        size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        scratch_path_t path = SCRATCH_HUGETLB;
+        uint8_t* p = map_hugetlb(size);
+        if (!p) {
+            path = SCRATCH_THP;
+            p = map_thp(size);
+        }
+        if (!p) {
+            return nullptr;
+        }
+        // the pages are faulted in by this thread, so that the kernel places
+        // them on the node this thread is running on.
+        for (size_t i = 0; i < size; i += HUGE_PAGE_SIZE) {
+            p[i] = 0;
+        }
+        try {
+            blocks.push_back(Block{ p, size, path, true });
+        } catch (...) {
+            munmap(p, size);
+            return nullptr;
+        }
+        count_scratch(path);
+        return p;
+    }
+
+    bool release(void* p) noexcept
+    {
+        for (auto& b : blocks) {
+            if (b.ptr == p) {
+                b.busy = false;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static thread_local ScratchPool scratch_pool;
+
+
+void* acquire_scratch(size_t size) noexcept
+{
+    // smaller buffers would waste most of a huge page.
+    if (size < HUGE_PAGE_SIZE / 2) {
+        return nullptr;
+    }
+    return scratch_pool.acquire(size);
+}
+
+
+void release_scratch(void* p) noexcept
+{
+    scratch_pool.release(p);
+}
+
+#else
+
+void* acquire_scratch(size_t) noexcept
+{
+    return nullptr;
+}
+
+
+void release_scratch(void*) noexcept {}
+
+#endif
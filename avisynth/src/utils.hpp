@@ -40,10 +40,54 @@ bool has_avx512(uint32_t info = 0) noexcept;
 
 bool has_avx512fp16(uint32_t info = 0) noexcept;
 
+// size of the last level cache in bytes, or 0 if it is unknown.
+size_t get_llc_size() noexcept;
+
 
 std::vector<std::string> split(const std::string& str, const char* separator) noexcept;
 
 uint32_t get_halfvalue(int bits);
 
+
+// rounds rowsize up to a multiple of align. an odd multiple, which keeps
+// consecutive rows off the same cache sets, made no difference beyond noise
+// in the sweep of tcanny_bench --pitch over widths of 1000 to 8192.
+size_t plan_pitch(size_t rowsize, size_t align) noexcept;
+
+
+// a region of the scratch buffer and the stages in which it is live.
+struct ScratchRegion {
+    size_t size;
+    int first;
+    int last;
+    size_t offset;
+};
+
+// assigns offsets to the regions so that regions live in the same stage
+// never overlap, and returns the total size.
+size_t plan_scratch(std::vector<ScratchRegion>& regions, size_t align);
+
+bool scratch_overlaps(const std::vector<ScratchRegion>& regions) noexcept;
+
+
+enum scratch_path_t {
+    SCRATCH_HUGETLB,
+    SCRATCH_THP,
+    SCRATCH_DEFAULT,
+    NUM_SCRATCH_PATHS,
+};
+
+// returns scratch memory backed by huge pages and placed on the NUMA node of
+// the calling thread, or nullptr if neither huge page path is available.
+// the memory is cached per thread and has to be released by the same thread.
+void* acquire_scratch(size_t size) noexcept;
+
+void release_scratch(void* p) noexcept;
+
+// counts how many scratch buffers were served by each scratch_path_t.
+void count_scratch(scratch_path_t path) noexcept;
+
+int64_t get_scratch_count(scratch_path_t path) noexcept;
+
 #endif // TCM_UTILS_HPP
 